@@ -1,4 +1,6 @@
-#pragma once 
+#pragma once
+
+#include <ostream>
 
 enum class DocumentStatus
 {
@@ -0,0 +1,61 @@
+#include "live_document_index.h"
+
+#include "memory_usage.h"
+
+void LiveDocumentIndex::Reset(std::size_t document_count)
+{
+    live_counts_.resize(document_count);
+    // Все документы живые: узел покрывает ровно i & -i документов
+    for (int i = 1; i <= static_cast<int>(document_count); ++i)
+    {
+        live_counts_[i - 1] = i & -i;
+    }
+}
+
+void LiveDocumentIndex::Add()
+{
+    const int i = static_cast<int>(live_counts_.size()) + 1;
+    // Узел i покрывает новый документ и узлы-потомки левее него
+    int live_count = 1;
+    for (int j = i - 1; j > i - (i & -i); j -= j & -j)
+    {
+        live_count += live_counts_[j - 1];
+    }
+    live_counts_.push_back(live_count);
+}
+
+void LiveDocumentIndex::Remove(int document_index)
+{
+    const int size = static_cast<int>(live_counts_.size());
+    for (int i = document_index + 1; i <= size; i += i & -i)
+    {
+        --live_counts_[i - 1];
+    }
+}
+
+int LiveDocumentIndex::GetDocumentIndex(int position) const
+{
+    const int size = static_cast<int>(live_counts_.size());
+    int step = 1;
+    while (step * 2 <= size)
+    {
+        step *= 2;
+    }
+    // Спуск по дереву: index - число документов левее искомого
+    int index = 0;
+    int remaining = position + 1;
+    for (; step > 0; step /= 2)
+    {
+        if (index + step <= size && live_counts_[index + step - 1] < remaining)
+        {
+            index += step;
+            remaining -= live_counts_[index - 1];
+        }
+    }
+    return index;
+}
+
+std::size_t LiveDocumentIndex::GetMemoryUsage() const
+{
+    return ::GetMemoryUsage(live_counts_);
+}
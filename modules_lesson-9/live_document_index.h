@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Порядковые номера неудалённых документов. Пока удалённые документы
+ * остаются в индексе, находит внутренний номер k-го неудалённого документа
+ * за O(log N) вместо перебора пометок об удалении.
+ * Хранит дерево Фенвика по числу неудалённых документов
+ */
+class LiveDocumentIndex
+{
+public:
+    /**
+     * Делает неудалёнными document_count документов с номерами 0..N-1
+     */
+    void Reset(std::size_t document_count);
+
+    // Добавляет неудалённый документ со следующим внутренним номером
+    void Add();
+
+    void Remove(int document_index);
+
+    /**
+     * Внутренний номер position-го по порядку неудалённого документа.
+     * position должен быть меньше числа неудалённых документов
+     */
+    int GetDocumentIndex(int position) const;
+
+    std::size_t GetMemoryUsage() const;
+
+private:
+    // live_counts_[i - 1] - число неудалённых документов среди номеров
+    // [i - (i & -i), i)
+    std::vector<int> live_counts_;
+};
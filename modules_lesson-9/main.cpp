@@ -1,4 +1,8 @@
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <execution>
 #include <map>
 #include <set>
 #include <string>
@@ -11,6 +15,8 @@
 #include "document.h"
 #include "search_server.h"
 #include "request_queue.h"
+#include "process_queries.h"
+#include "sharded_search_server.h"
 
 using namespace std;
 
@@ -190,6 +196,54 @@ void TestAddDocument()
                     "Server must contain two added documents"s);
 }
 
+// Проверяем, что пакетное добавление даёт тот же индекс, что и
+// добавление документов по одному, и не добавляет ничего при ошибке
+void TestAddDocuments()
+{
+  SearchServer server("and"s);
+  SearchServer expected_server("and"s);
+
+  vector<SearchServer::NewDocument> documents;
+  const vector<string> texts = {"cat and dog"s, "cat cat bird"s, "dog fish"s,
+                                "bird and fish"s, "cat"s};
+  for (int i = 0; i < static_cast<int>(texts.size()); ++i)
+  {
+    documents.push_back({i * 2, texts.at(i), DocumentStatus::ACTUAL, {i}});
+    expected_server.AddDocument(i * 2, texts.at(i), DocumentStatus::ACTUAL, {i});
+  }
+  server.AddDocuments(documents);
+
+  ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+  for (const string &query : {"cat"s, "dog -fish"s, "bird fish cat"s})
+  {
+    const vector<Document> result = server.FindTopDocuments(query);
+    const vector<Document> expected = expected_server.FindTopDocuments(query);
+    ASSERT_EQUAL(result.size(), expected.size());
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+      ASSERT_EQUAL(result.at(i).id, expected.at(i).id);
+      ASSERT_EQUAL(result.at(i).rating, expected.at(i).rating);
+      ASSERT(abs(result.at(i).relevance - expected.at(i).relevance) < EPSILON);
+    }
+  }
+  ASSERT_EQUAL(server.GetWordFrequencies(2), expected_server.GetWordFrequencies(2));
+
+  // Некорректное слово в одном документе отменяет добавление всего пакета
+  ASSERT_CODE
+  server.AddDocuments({{20, "good"sv, DocumentStatus::ACTUAL, {}},
+                       {21, "bad-"sv, DocumentStatus::ACTUAL, {}}});
+  THROWS(invalid_argument)
+  ASSERT_EQUAL(server.GetDocumentCount(), 5);
+  ASSERT(server.FindTopDocuments("good"s).empty());
+
+  // Повтор ID внутри пакета
+  ASSERT_CODE
+  server.AddDocuments({{30, "a"sv, DocumentStatus::ACTUAL, {}},
+                       {30, "b"sv, DocumentStatus::ACTUAL, {}}});
+  THROWS(invalid_argument)
+  ASSERT_EQUAL(server.GetDocumentCount(), 5);
+}
+
 // Тест проверяет, что добавленные документы можно найти по запросу
 void TestAddedDocumentCanBeFound()
 {
@@ -216,6 +270,259 @@ void TestAddedDocumentCanBeFound()
   ASSERT_EQUAL_HINT(documents.size(), 3, "All 3 added documents must be found");
 }
 
+// Тест проверяет, что документы находятся независимо от порядка, в котором
+// добавлялись их ID, и что повторы слова в документе суммируют его TF
+void TestDocumentsAddedInAnyIdOrderCanBeFound()
+{
+  SearchServer server;
+  server.AddDocument(5, "cat dog"s, DocumentStatus::ACTUAL, {1});
+  server.AddDocument(1, "cat cat cat bird"s, DocumentStatus::ACTUAL, {2});
+  server.AddDocument(3, "cat fish"s, DocumentStatus::ACTUAL, {3});
+
+  const vector<Document> documents = server.FindTopDocuments("cat bird"s);
+  ASSERT_EQUAL(documents.size(), 3);
+  ASSERT_EQUAL_HINT(documents.at(0).id, 1,
+                    "Document with 'bird' must be the most relevant"s);
+
+  const auto [words, status] = server.MatchDocument("cat fish"s, 3);
+  const vector<string_view> expected_words = {"cat"sv, "fish"sv};
+  ASSERT_EQUAL(words, expected_words);
+}
+
+// Тест проверяет, что слова запроса, которых нет ни в одном документе,
+// не влияют на выдачу, а MatchDocument возвращает слова в алфавитном порядке
+void TestQueryWordsResolvedAgainstDictionary()
+{
+  SearchServer server("and"s);
+  server.AddDocument(0, "zebra and apple"s, DocumentStatus::ACTUAL, {1});
+  server.AddDocument(1, "apple pie"s, DocumentStatus::ACTUAL, {1});
+
+  ASSERT_EQUAL(server.FindTopDocuments("apple -unknown"s).size(), 2);
+  ASSERT(server.FindTopDocuments("unknown and"s).empty());
+
+  const auto [words, status] =
+      server.MatchDocument("zebra apple apple unknown and"s, 0);
+  const vector<string_view> expected_words = {"apple"sv, "zebra"sv};
+  ASSERT_EQUAL(words, expected_words);
+}
+
+// Тест проверяет, что MatchDocument и предикат работают с внешними ID
+// документов, даже если они идут не подряд
+void TestExternalDocumentIdsAreTranslated()
+{
+  SearchServer server;
+  server.AddDocument(100, "cat"s, DocumentStatus::BANNED, {5});
+  server.AddDocument(7, "cat dog"s, DocumentStatus::ACTUAL, {1});
+
+  const vector<Document> documents = server.FindTopDocuments(
+      "cat"s, [](const int id, const auto &status, const int rating)
+      { return id == 100 && status == DocumentStatus::BANNED && rating == 5; });
+  ASSERT_EQUAL(documents.size(), 1);
+  ASSERT_EQUAL(documents.at(0).id, 100);
+  ASSERT_EQUAL(documents.at(0).rating, 5);
+
+  ASSERT_EQUAL(get<1>(server.MatchDocument("dog"s, 7)), DocumentStatus::ACTUAL);
+
+  ASSERT_CODE
+  server.MatchDocument("cat"s, 1);
+  THROWS(out_of_range)
+}
+
+// Тест проверяет, что сервер принимает string_view, указывающие внутрь
+// чужого буфера, и что найденные MatchDocument слова не зависят от запроса
+void TestStringViewQueriesFromBuffer()
+{
+  const string buffer = "stop|cat in town|cat -dog"s;
+  const string_view view = buffer;
+
+  SearchServer server(view.substr(0, 4));
+  server.AddDocument(0, view.substr(5, 11), DocumentStatus::ACTUAL, {1});
+  server.AddDocument(1, "dog stop cat"sv, DocumentStatus::ACTUAL, {1});
+
+  const vector<Document> documents = server.FindTopDocuments(view.substr(17));
+  ASSERT_EQUAL(documents.size(), 1);
+  ASSERT_EQUAL(documents.at(0).id, 0);
+  ASSERT(server.FindTopDocuments("stop"sv).empty());
+
+  vector<string_view> words;
+  {
+    string query = "town cat"s;
+    words = get<0>(server.MatchDocument(query, 0));
+    query = "xxxx xxx"s;
+  }
+  const vector<string_view> expected_words = {"cat"sv, "town"sv};
+  ASSERT_EQUAL(words, expected_words);
+}
+
+// Проверяем, что удалённый документ сразу пропадает из выдачи, а IDF
+// считается только по оставшимся документам — и до, и после уплотнения
+void TestRemoveDocument()
+{
+  SearchServer server;
+  server.AddDocument(0, "white cat"s, DocumentStatus::ACTUAL, {1});
+  server.AddDocument(1, "black cat"s, DocumentStatus::ACTUAL, {2});
+  server.AddDocument(2, "black dog"s, DocumentStatus::ACTUAL, {3});
+  server.AddDocument(3, "white dog"s, DocumentStatus::ACTUAL, {4});
+
+  SearchServer expected_server;
+  expected_server.AddDocument(0, "white cat"s, DocumentStatus::ACTUAL, {1});
+  expected_server.AddDocument(2, "black dog"s, DocumentStatus::ACTUAL, {3});
+  expected_server.AddDocument(3, "white dog"s, DocumentStatus::ACTUAL, {4});
+
+  const auto assert_same_result = [&server, &expected_server](const string &query)
+  {
+    const vector<Document> documents = server.FindTopDocuments(query);
+    const vector<Document> expected = expected_server.FindTopDocuments(query);
+    ASSERT_EQUAL(documents.size(), expected.size());
+    for (size_t i = 0; i < documents.size(); ++i)
+    {
+      ASSERT_EQUAL(documents.at(i).id, expected.at(i).id);
+      ASSERT(abs(documents.at(i).relevance - expected.at(i).relevance) < EPSILON);
+    }
+  };
+
+  // Удаление несуществующего документа ничего не меняет
+  server.RemoveDocument(42);
+  ASSERT_EQUAL(server.GetDocumentCount(), 4);
+
+  // Одно удаление из четырёх не превышает порог уплотнения
+  server.RemoveDocument(1);
+  ASSERT_EQUAL(server.GetDocumentCount(), 3);
+  ASSERT(server.GetWordFrequencies(1).empty());
+  ASSERT_EQUAL(server.GetDocumentId(1), 2);
+  assert_same_result("black cat"s);
+  assert_same_result("white -dog"s);
+
+  // Второе удаление запускает уплотнение
+  server.RemoveDocument(2);
+  expected_server.RemoveDocument(2);
+  ASSERT_EQUAL(server.GetDocumentCount(), 2);
+  ASSERT_EQUAL(server.GetDocumentId(1), 3);
+  assert_same_result("black cat"s);
+  assert_same_result("white dog"s);
+  ASSERT_EQUAL(get<0>(server.MatchDocument("white dog"s, 3)).size(), 2);
+
+  // ID удалённого документа можно использовать повторно
+  server.AddDocument(1, "black dog"s, DocumentStatus::ACTUAL, {5});
+  expected_server.AddDocument(1, "black dog"s, DocumentStatus::ACTUAL, {5});
+  assert_same_result("black dog"s);
+}
+
+// Тест проверяет, что GetDocumentId нумерует по порядку только неудалённые
+// документы, пока удалённые ещё не вычищены уплотнением
+void TestGetDocumentIdSkipsRemovedDocuments()
+{
+  SearchServer server;
+  vector<int> expected_ids;
+  for (int id = 0; id < 100; ++id)
+  {
+    server.AddDocument(id * 2, "cat"s, DocumentStatus::ACTUAL, {});
+    expected_ids.push_back(id * 2);
+  }
+  // Удаляется каждый пятый документ: меньше порога уплотнения
+  for (int id = 0; id < 200; id += 10)
+  {
+    server.RemoveDocument(id);
+    expected_ids.erase(find(expected_ids.begin(), expected_ids.end(), id));
+  }
+  server.AddDocuments({{1, "dog"s, DocumentStatus::ACTUAL, {}},
+                       {3, "dog"s, DocumentStatus::BANNED, {}}});
+  server.AddDocument(5, "dog"s, DocumentStatus::ACTUAL, {});
+  server.RemoveDocument(3);
+  expected_ids.push_back(1);
+  expected_ids.push_back(5);
+
+  ASSERT_EQUAL(server.GetDocumentCount(), static_cast<int>(expected_ids.size()));
+  for (size_t i = 0; i < expected_ids.size(); ++i)
+  {
+    ASSERT_EQUAL(server.GetDocumentId(static_cast<int>(i)), expected_ids[i]);
+  }
+  ASSERT_CODE
+  server.GetDocumentId(static_cast<int>(expected_ids.size()));
+  THROWS(out_of_range)
+}
+
+// Проверяем, что сжатые списки вхождений дают ту же выдачу, что и обычные,
+// в том числе для списков из нескольких блоков и после уплотнения
+void TestCompressedPostingLists()
+{
+  SearchServer plain_server;
+  SearchServer compressed_server;
+  compressed_server.SetPostingListEncoding(PostingListEncoding::COMPRESSED);
+
+  for (int i = 0; i < 300; ++i)
+  {
+    const string text = "common"s + (i % 3 == 0 ? " three"s : ""s) +
+                        (i % 7 == 0 ? " seven seven"s : ""s) + " w"s +
+                        to_string(i);
+    plain_server.AddDocument(i * 5, text, DocumentStatus::ACTUAL, {i % 10});
+    // Половина документов добавляется до смены кодировки
+    if (i == 150)
+    {
+      compressed_server.SetPostingListEncoding(PostingListEncoding::PLAIN);
+    }
+    compressed_server.AddDocument(i * 5, text, DocumentStatus::ACTUAL, {i % 10});
+    if (i == 150)
+    {
+      compressed_server.SetPostingListEncoding(PostingListEncoding::COMPRESSED);
+    }
+  }
+
+  const auto assert_same_result = [&plain_server, &compressed_server]()
+  {
+    for (const string &query : {"seven"s, "three -seven"s, "common w42"s})
+    {
+      const vector<Document> expected = plain_server.FindTopDocuments(query);
+      const vector<Document> result = compressed_server.FindTopDocuments(query);
+      ASSERT_EQUAL(result.size(), expected.size());
+      for (size_t i = 0; i < result.size(); ++i)
+      {
+        ASSERT_EQUAL(result.at(i).id, expected.at(i).id);
+        ASSERT(abs(result.at(i).relevance - expected.at(i).relevance) < EPSILON);
+      }
+    }
+  };
+  assert_same_result();
+
+  for (int i = 0; i < 300; i += 2)
+  {
+    plain_server.RemoveDocument(i * 5);
+    compressed_server.RemoveDocument(i * 5);
+  }
+  assert_same_result();
+}
+
+// Проверяем счётчики GetMemoryStats и то, что сжатие уменьшает
+// объём памяти под списки вхождений
+void TestGetMemoryStats()
+{
+  SearchServer server("in the"s);
+  const SearchServer::MemoryStats empty_stats = server.GetMemoryStats();
+  ASSERT_EQUAL(empty_stats.term_count, 2);
+  ASSERT_EQUAL(empty_stats.posting_count, 0);
+  ASSERT(empty_stats.stop_words_bytes > 0);
+
+  server.AddDocument(0, "cat in the city"s, DocumentStatus::ACTUAL, {});
+  server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, {});
+  const SearchServer::MemoryStats stats = server.GetMemoryStats();
+  ASSERT_EQUAL(stats.term_count, 5);
+  ASSERT_EQUAL(stats.posting_count, 4);
+  ASSERT(abs(stats.average_posting_length - 4.0 / 3.0) < EPSILON);
+  ASSERT(stats.term_dictionary_bytes > empty_stats.term_dictionary_bytes);
+  ASSERT(stats.postings_bytes > 0);
+  ASSERT(stats.document_metadata_bytes > 0);
+  ASSERT(stats.document_ids_bytes > 0);
+
+  SearchServer big_server;
+  for (int i = 0; i < 1000; ++i)
+  {
+    big_server.AddDocument(i, "common word"s, DocumentStatus::ACTUAL, {});
+  }
+  const size_t plain_bytes = big_server.GetMemoryStats().postings_bytes;
+  big_server.SetPostingListEncoding(PostingListEncoding::COMPRESSED);
+  ASSERT(big_server.GetMemoryStats().postings_bytes * 2 < plain_bytes);
+}
+
 // Тест проверяет, что минус-слово в запросе исключает из выдачи документы,
 // которые содеражат такое слово
 void TestExcludeDocumentsWithMinusWordsFromSearchResult()
@@ -242,6 +549,727 @@ void TestExcludeDocumentsWithMinusWordsFromSearchResult()
               "Minus-word 'cat' must exclude all documents from result"s);
 }
 
+// Проверяем, что предикат не вызывается для документов с минус-словами
+void TestPredicateIsNotCalledForExcludedDocuments()
+{
+  SearchServer server;
+  server.AddDocument(0, "cat dog"s, DocumentStatus::ACTUAL, {});
+  server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {});
+  server.AddDocument(2, "cat dog bird"s, DocumentStatus::ACTUAL, {});
+
+  set<int> checked_ids;
+  const vector<Document> documents = server.FindTopDocuments(
+      "cat bird -dog"s,
+      [&checked_ids](const int id, const auto &, const auto &)
+      {
+        checked_ids.insert(id);
+        return true;
+      });
+  ASSERT_EQUAL(documents.size(), 1);
+  ASSERT_EQUAL(documents.at(0).id, 1);
+  ASSERT_EQUAL(checked_ids, set<int>{1});
+}
+
+// Тест проверяет обход списка вхождений курсором с пропусками
+// и границы TF по блокам для обеих кодировок
+void TestPostingListCursorAndBlockBounds()
+{
+  for (const PostingListEncoding encoding :
+       {PostingListEncoding::PLAIN, PostingListEncoding::COMPRESSED})
+  {
+    PostingList postings(encoding);
+    const int size = 3 * static_cast<int>(PostingList::BLOCK_SIZE) + 10;
+    for (int i = 0; i < size; ++i)
+    {
+      // В первом блоке у документа 200 наибольший TF
+      postings.Add(i * 2, i == 100 ? 3 : 1, 4);
+    }
+    ASSERT_EQUAL(postings.GetMaxTermFreq(), 0.75);
+
+    PostingList::Cursor cursor(postings);
+    ASSERT(!cursor.IsEnd());
+    ASSERT_EQUAL(cursor.GetDocumentIndex(), 0);
+    cursor.Next();
+    ASSERT_EQUAL(cursor.GetDocumentIndex(), 2);
+
+    cursor.SkipTo(199);
+    ASSERT_EQUAL(cursor.GetDocumentIndex(), 200);
+    ASSERT_EQUAL(cursor.GetCount(), 3);
+    cursor.SkipTo(200);
+    ASSERT_EQUAL(cursor.GetDocumentIndex(), 200);
+
+    cursor.SkipBlocksTo(300);
+    ASSERT_EQUAL(cursor.GetBlockMaxTermFreq(), 0.25);
+    ASSERT_EQUAL(cursor.GetBlockLastDocumentIndex(), 2 * (2 * 128 - 1));
+    // Сдвиг по границам не трогает текущее вхождение
+    ASSERT_EQUAL(cursor.GetDocumentIndex(), 200);
+
+    cursor.SkipTo(2 * size - 2);
+    ASSERT_EQUAL(cursor.GetDocumentIndex(), 2 * size - 2);
+    cursor.Next();
+    ASSERT(cursor.IsEnd());
+
+    PostingList::Cursor past_end(postings);
+    past_end.SkipTo(2 * size);
+    ASSERT(past_end.IsEnd());
+    past_end.SkipBlocksTo(2 * size);
+    ASSERT_EQUAL(past_end.GetBlockMaxTermFreq(), 0.0);
+
+    // После удаления документа 200 граница TF его блока пересчитывается
+    vector<int> new_indexes(2 * size, -1);
+    vector<int> document_word_counts;
+    for (int i = 0; i < size; ++i)
+    {
+      if (i != 100)
+      {
+        new_indexes[i * 2] = static_cast<int>(document_word_counts.size());
+        document_word_counts.push_back(4);
+      }
+    }
+    postings.RenumberDocuments(new_indexes, document_word_counts);
+    PostingList::Cursor renumbered(postings);
+    renumbered.SkipBlocksTo(0);
+    ASSERT_EQUAL(renumbered.GetBlockMaxTermFreq(), 0.25);
+
+    // Числа вхождений от 65535 хранятся без потерь
+    PostingList large_counts(encoding);
+    const vector<TermCount> counts = {1, 70000, 65535, 65534, 100000};
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+      large_counts.Add(static_cast<int>(i), counts[i], 100000);
+    }
+    vector<TermCount> stored_counts;
+    large_counts.ForEachPosting([&stored_counts](int, TermCount count)
+                                { stored_counts.push_back(count); });
+    ASSERT_EQUAL(stored_counts, counts);
+    PostingList::Cursor large_cursor(large_counts);
+    large_cursor.SkipTo(2);
+    ASSERT_EQUAL(large_cursor.GetCount(), 65535);
+    large_cursor.SkipTo(4);
+    ASSERT_EQUAL(large_cursor.GetCount(), 100000);
+  }
+}
+
+// Тест проверяет, что IDF слова следит за числом документов и числом
+// документов со словом при добавлении, пакетном добавлении и удалении
+void TestInverseDocumentFreqFollowsIndexChanges()
+{
+  SearchServer server;
+  server.AddDocument(0, "cat dog"s, DocumentStatus::ACTUAL, {});
+  server.AddDocument(1, "dog"s, DocumentStatus::ACTUAL, {});
+
+  // 'cat': log(2 / 1), TF 1 / 2
+  ASSERT(abs(server.FindTopDocuments("cat"s).at(0).relevance - log(2.0) / 2) < EPSILON);
+
+  server.AddDocuments({{2, "bird"sv, DocumentStatus::ACTUAL, {}},
+                       {3, "cat bird"sv, DocumentStatus::ACTUAL, {}}});
+  // 'cat': log(4 / 2); 'dog' при этом тоже меняет IDF: log(4 / 2)
+  ASSERT(abs(server.FindTopDocuments("cat"s).at(0).relevance - log(2.0) / 2) < EPSILON);
+  ASSERT(abs(server.FindTopDocuments("dog"s).at(0).relevance - log(2.0)) < EPSILON);
+
+  server.RemoveDocument(3);
+  // 'cat': log(3 / 1), 'bird': log(3 / 1)
+  ASSERT(abs(server.FindTopDocuments("cat"s).at(0).relevance - log(3.0) / 2) < EPSILON);
+  ASSERT(abs(server.FindTopDocuments("bird"s).at(0).relevance - log(3.0)) < EPSILON);
+
+  // Удаление второго документа запускает уплотнение, IDF при этом не меняется
+  server.RemoveDocument(2);
+  ASSERT(abs(server.FindTopDocuments("cat"s).at(0).relevance - log(2.0) / 2) < EPSILON);
+  ASSERT(server.FindTopDocuments("bird"s).empty());
+}
+
+// Тест проверяет, что поиск по редкому статусу, который обходит только
+// документы с этим статусом, даёт ту же выдачу, что и поиск с предикатом
+void TestFindTopDocumentsByRareStatus()
+{
+  SearchServer server("and"s);
+  for (int id = 0; id < 300; ++id)
+  {
+    const DocumentStatus status =
+        id % 50 == 7 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+    const string text = id % 2 == 0 ? "cat and dog"s : "cat and white collar"s;
+    server.AddDocument(id, text + (id % 3 == 0 ? " bird"s : ""s), status, {id % 7});
+  }
+  server.RemoveDocument(57);
+
+  // Частый статус ищется по спискам вхождений, редкий - перебором документов
+  for (const DocumentStatus expected_status : {DocumentStatus::BANNED, DocumentStatus::ACTUAL})
+  {
+    for (const string &query : {"cat"s, "cat collar"s, "cat -bird"s, "dog bird"s})
+    {
+      QueryOptions options;
+      options.limit = 10;
+      const vector<Document> documents =
+          server.FindTopDocuments(query, expected_status, options);
+      const vector<Document> expected = server.FindTopDocuments(
+          query,
+          [expected_status](int, DocumentStatus status, int)
+          { return status == expected_status; },
+          options);
+      ASSERT_EQUAL_HINT(documents.size(), expected.size(), query);
+      for (size_t i = 0; i < documents.size(); ++i)
+      {
+        ASSERT_EQUAL_HINT(documents[i].id, expected[i].id, query);
+        ASSERT_EQUAL_HINT(documents[i].relevance, expected[i].relevance, query);
+      }
+    }
+  }
+  ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentStatus::BANNED).size(), 5);
+  ASSERT(server.FindTopDocuments("cat"s, DocumentStatus::REMOVED).empty());
+}
+
+// Тест проверяет кэш результатов: попадания для одинаковых после разбора
+// запросов, сброс при изменении индекса и ограничение объёма
+void TestQueryCache()
+{
+  SearchServer server("and"s);
+  server.AddDocument(0, "cat and dog"s, DocumentStatus::ACTUAL, {1});
+  server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {2});
+  server.AddDocument(2, "dog"s, DocumentStatus::BANNED, {3});
+
+  // Выключенный кэш ничего не считает
+  server.FindTopDocuments("cat"s);
+  ASSERT_EQUAL(server.GetQueryCacheStats().misses, 0);
+
+  server.EnableQueryCache(1 << 20);
+  const vector<Document> documents = server.FindTopDocuments("cat dog"s);
+  ASSERT_EQUAL(server.GetQueryCacheStats().misses, 1);
+  ASSERT_EQUAL(server.GetQueryCacheStats().entry_count, 1);
+
+  // Порядок, повторы, стоп-слова и неизвестные слова не меняют ключ
+  const vector<Document> cached = server.FindTopDocuments("dog and cat cat fish"s);
+  ASSERT_EQUAL(server.GetQueryCacheStats().hits, 1);
+  ASSERT_EQUAL(cached.size(), documents.size());
+  for (size_t i = 0; i < cached.size(); ++i)
+  {
+    ASSERT_EQUAL(cached[i].id, documents[i].id);
+    ASSERT_EQUAL(cached[i].relevance, documents[i].relevance);
+  }
+
+  // Другой статус или страница - другой ключ
+  server.FindTopDocuments("cat dog"s, DocumentStatus::BANNED);
+  QueryOptions options;
+  options.offset = 1;
+  server.FindTopDocuments("cat dog"s, options);
+  ASSERT_EQUAL(server.GetQueryCacheStats().misses, 3);
+
+  // Изменение индекса сбрасывает кэш
+  server.AddDocument(3, "black cat"s, DocumentStatus::ACTUAL, {4});
+  ASSERT_EQUAL(server.FindTopDocuments("cat dog"s).size(), 3);
+  ASSERT_EQUAL(server.GetQueryCacheStats().misses, 4);
+  ASSERT_EQUAL(server.GetQueryCacheStats().entry_count, 1);
+  server.RemoveDocument(3);
+  ASSERT_EQUAL(server.FindTopDocuments("cat dog"s).size(), 2);
+  ASSERT_EQUAL(server.GetQueryCacheStats().misses, 5);
+
+  // Предикаты не кэшируются
+  server.FindTopDocuments("cat"s, [](int, DocumentStatus, int) { return true; });
+  ASSERT_EQUAL(server.GetQueryCacheStats().misses, 5);
+
+  // Выдачи с IDF по статистике коллекции хранятся отдельно для каждой статистики
+  const SearchServer::PreparedQuery collection_query =
+      server.PrepareQuery("cat dog"s, 20, {{"cat"sv, 2}, {"dog"sv, 10}});
+  const vector<Document> collection_documents = server.FindTopDocuments(collection_query);
+  ASSERT_EQUAL(server.GetQueryCacheStats().misses, 6);
+  ASSERT(abs(collection_documents.at(0).relevance -
+             server.FindTopDocuments("cat dog"s).at(0).relevance) > EPSILON);
+  const size_t hits = server.GetQueryCacheStats().hits;
+  const vector<Document> cached_documents = server.FindTopDocuments(collection_query);
+  ASSERT_EQUAL(server.GetQueryCacheStats().hits, hits + 1);
+  ASSERT_EQUAL(cached_documents.size(), collection_documents.size());
+  ASSERT_EQUAL(cached_documents.at(0).relevance, collection_documents.at(0).relevance);
+  server.FindTopDocuments(server.PrepareQuery("cat dog"s, 30, {{"cat"sv, 2}, {"dog"sv, 10}}));
+  ASSERT_EQUAL(server.GetQueryCacheStats().misses, 7);
+
+  // Маленький кэш вытесняет давно не использованные записи
+  server.EnableQueryCache(400);
+  for (const string &query : {"cat"s, "dog"s, "white"s, "cat dog white"s})
+  {
+    server.FindTopDocuments(query);
+  }
+  const QueryCache::Stats stats = server.GetQueryCacheStats();
+  ASSERT(stats.bytes <= 400);
+  ASSERT(0 < stats.entry_count && stats.entry_count < 4);
+
+  server.DisableQueryCache();
+  ASSERT_EQUAL(server.GetQueryCacheStats().entry_count, 0);
+}
+
+// Тест проверяет, что подготовленный запрос даёт те же результаты, что и
+// текстовый, и разбирается заново после изменения индекса
+void TestPreparedQuery()
+{
+  SearchServer server("and"s);
+  server.AddDocument(0, "cat and dog"s, DocumentStatus::ACTUAL, {1});
+  server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {2});
+  server.AddDocument(2, "dog collar"s, DocumentStatus::BANNED, {3});
+
+  ASSERT_CODE
+  server.PrepareQuery("cat --dog"s);
+  THROWS(invalid_argument)
+
+  const string raw_query = "cat collar bird -white"s;
+  const SearchServer::PreparedQuery query = server.PrepareQuery(raw_query);
+  const vector<Document> expected = server.FindTopDocuments(raw_query);
+  const vector<Document> documents = server.FindTopDocuments(query);
+  ASSERT_EQUAL(documents.size(), expected.size());
+  for (size_t i = 0; i < documents.size(); ++i)
+  {
+    ASSERT_EQUAL(documents[i].id, expected[i].id);
+    ASSERT_EQUAL(documents[i].relevance, expected[i].relevance);
+  }
+  ASSERT_EQUAL(server.FindTopDocuments(query, DocumentStatus::BANNED, {}).size(), 1);
+  ASSERT_EQUAL(server.FindTopDocuments(
+                         query, [](int id, DocumentStatus, int) { return id > 0; }, {})
+                   .size(),
+               1);
+
+  for (const int id : {0, 1, 2})
+  {
+    const auto [words, status] = server.MatchDocument(query, id);
+    const auto [expected_words, expected_status] = server.MatchDocument(raw_query, id);
+    ASSERT_EQUAL(words, expected_words);
+    ASSERT_EQUAL(status, expected_status);
+  }
+
+  // Слово 'bird' появляется в индексе после подготовки запроса
+  server.AddDocument(3, "bird"s, DocumentStatus::ACTUAL, {4});
+  ASSERT_EQUAL(server.FindTopDocuments(query).size(), 2);
+  ASSERT_EQUAL(get<0>(server.MatchDocument(query, 3)), vector<string_view>{"bird"sv});
+
+  // На другом сервере с тем же числом изменений индекса запрос разбирается
+  // заново: номера слов там другие, а в маленьком словаре их нет вовсе
+  SearchServer other_server("and"s);
+  other_server.AddDocument(5, "bird and collar"s, DocumentStatus::ACTUAL, {1});
+  other_server.AddDocument(6, "cat"s, DocumentStatus::ACTUAL, {2});
+  other_server.AddDocument(8, "white"s, DocumentStatus::ACTUAL, {3});
+  const vector<Document> other_documents = other_server.FindTopDocuments(query);
+  const vector<Document> other_expected = other_server.FindTopDocuments(raw_query);
+  ASSERT_EQUAL(other_documents.size(), other_expected.size());
+  for (size_t i = 0; i < other_documents.size(); ++i)
+  {
+    ASSERT_EQUAL(other_documents[i].id, other_expected[i].id);
+    ASSERT_EQUAL(other_documents[i].relevance, other_expected[i].relevance);
+  }
+  ASSERT_EQUAL(get<0>(other_server.MatchDocument(query, 5)),
+               (vector<string_view>{"bird"sv, "collar"sv}));
+
+  SearchServer small_server;
+  small_server.AddDocument(7, "fish"s, DocumentStatus::ACTUAL, {1});
+  small_server.AddDocument(9, "fish"s, DocumentStatus::ACTUAL, {1});
+  small_server.RemoveDocument(9);
+  ASSERT(small_server.FindTopDocuments(query).empty());
+  ASSERT(get<0>(small_server.MatchDocument(query, 7)).empty());
+}
+
+// Тест проверяет, что параллельный поиск даёт ту же выдачу, что и
+// последовательный, во всех вариантах поиска
+void TestParallelFindTopDocuments()
+{
+  const vector<string> words = {"cat"s, "dog"s, "bird"s, "fish"s, "city"s,
+                                "tail"s, "collar"s, "eyes"s};
+  SearchServer server("and"s);
+  unsigned seed = 7;
+  const auto next_random = [&seed](unsigned bound)
+  {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % bound;
+  };
+  for (int id = 0; id < 500; ++id)
+  {
+    string text;
+    const unsigned length = 1 + next_random(6);
+    for (unsigned i = 0; i < length; ++i)
+    {
+      text += words[next_random(words.size())] + " and "s;
+    }
+    // Рейтинги повторяются, поэтому при равной релевантности
+    // порядок определяют рейтинг и ID
+    server.AddDocument(id, text,
+                       id % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL,
+                       {static_cast<int>(next_random(3))});
+  }
+
+  const auto assert_equal_documents = [](const vector<Document> &documents,
+                                         const vector<Document> &expected,
+                                         const string &hint)
+  {
+    ASSERT_EQUAL_HINT(documents.size(), expected.size(), hint);
+    for (size_t i = 0; i < documents.size(); ++i)
+    {
+      ASSERT_EQUAL_HINT(documents[i].id, expected[i].id, hint);
+      ASSERT_EQUAL_HINT(documents[i].relevance, expected[i].relevance, hint);
+    }
+  };
+  const auto is_even = [](int id, DocumentStatus, int) { return id % 2 == 0; };
+  for (const string &query : {"cat"s, "dog bird -fish"s, "city tail collar eyes"s, "fish -fish"s})
+  {
+    for (const RetrievalMode mode : {RetrievalMode::EXHAUSTIVE, RetrievalMode::PRUNED})
+    {
+      QueryOptions options;
+      options.limit = 20;
+      options.mode = mode;
+      assert_equal_documents(server.FindTopDocuments(execution::par, query, options),
+                             server.FindTopDocuments(query, options), query);
+      assert_equal_documents(
+          server.FindTopDocuments(execution::par, query, DocumentStatus::BANNED, options),
+          server.FindTopDocuments(query, DocumentStatus::BANNED, options), query);
+      assert_equal_documents(server.FindTopDocuments(execution::par, query, is_even, options),
+                             server.FindTopDocuments(query, is_even, options), query);
+    }
+    assert_equal_documents(server.FindTopDocuments(execution::par, query),
+                           server.FindTopDocuments(query), query);
+    assert_equal_documents(server.FindTopDocuments(execution::seq, query, is_even),
+                           server.FindTopDocuments(query, is_even), query);
+    assert_equal_documents(
+        server.FindTopDocuments(execution::par, query, DocumentStatus::BANNED),
+        server.FindTopDocuments(query, DocumentStatus::BANNED), query);
+  }
+}
+
+// Тест проверяет параллельный MatchDocument: слова отсортированы и не
+// повторяются, минус-слово обнуляет выдачу, результат совпадает
+// с последовательным
+void TestParallelMatchDocument()
+{
+  SearchServer server("and with"s);
+  server.AddDocument(0, "white cat and yellow hat"s, DocumentStatus::ACTUAL, {});
+  server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::BANNED, {});
+  server.AddDocument(2, "nasty dog with big eyes"s, DocumentStatus::ACTUAL, {});
+
+  const string query = "curly and funny -nasty cat cat hat curly white tail tail"s;
+  {
+    const auto [words, status] = server.MatchDocument(execution::par, query, 1);
+    const vector<string_view> expected = {"cat"sv, "curly"sv, "tail"sv};
+    ASSERT_EQUAL(words, expected);
+    ASSERT_EQUAL(status, DocumentStatus::BANNED);
+  }
+  {
+    const auto [words, status] = server.MatchDocument(execution::par, query, 2);
+    ASSERT(words.empty());
+    ASSERT_EQUAL(status, DocumentStatus::ACTUAL);
+  }
+  const SearchServer::PreparedQuery prepared = server.PrepareQuery(query);
+  for (const int id : {0, 1, 2})
+  {
+    const auto [words, status] = server.MatchDocument(execution::par, prepared, id);
+    const auto [expected_words, expected_status] = server.MatchDocument(query, id);
+    ASSERT_EQUAL(words, expected_words);
+    ASSERT_EQUAL(status, expected_status);
+  }
+
+  ASSERT_CODE
+  server.MatchDocument(execution::par, query, 3);
+  THROWS(out_of_range)
+}
+
+// Тест проверяет, что пакетная обработка запросов возвращает выдачи
+// в порядке запросов, как при последовательных вызовах
+void TestProcessQueries()
+{
+  SearchServer server("and with"s);
+  int id = 0;
+  for (const string &text : {"funny pet and nasty rat"s, "funny pet with curly hair"s,
+                             "funny pet and not very nasty rat"s, "pet with rat and rat and rat"s,
+                             "nasty rat with curly hair"s})
+  {
+    server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+  }
+  const vector<string> queries = {"nasty rat -not"s, "not very funny nasty pet"s,
+                                  "curly hair"s, "unknown"s};
+
+  const vector<vector<Document>> documents_lists = ProcessQueries(server, queries);
+  ASSERT_EQUAL(documents_lists.size(), queries.size());
+  vector<Document> expected_joined;
+  for (size_t i = 0; i < queries.size(); ++i)
+  {
+    const vector<Document> expected = server.FindTopDocuments(queries[i]);
+    ASSERT_EQUAL(documents_lists[i].size(), expected.size());
+    for (size_t j = 0; j < expected.size(); ++j)
+    {
+      ASSERT_EQUAL(documents_lists[i][j].id, expected[j].id);
+    }
+    expected_joined.insert(expected_joined.end(), expected.begin(), expected.end());
+  }
+  ASSERT_EQUAL(documents_lists[2].size(), 2);
+  ASSERT(documents_lists[3].empty());
+
+  const vector<Document> joined = ProcessQueriesJoined(server, queries);
+  ASSERT_EQUAL(joined.size(), expected_joined.size());
+  for (size_t i = 0; i < joined.size(); ++i)
+  {
+    ASSERT_EQUAL(joined[i].id, expected_joined[i].id);
+    ASSERT_EQUAL(joined[i].relevance, expected_joined[i].relevance);
+  }
+  ASSERT(ProcessQueriesJoined(server, {}).empty());
+}
+
+// Тест проверяет, что индекс из нескольких шардов даёт ту же выдачу,
+// что и один сервер с теми же документами
+void TestShardedSearchServer()
+{
+  const vector<string> words = {"cat"s, "dog"s, "bird"s, "fish"s, "city"s,
+                                "tail"s, "collar"s, "eyes"s};
+  SearchServer server("and"s);
+  ShardedSearchServer sharded_server(3, "and"s);
+  ASSERT_EQUAL(sharded_server.GetShardCount(), 3);
+  unsigned seed = 11;
+  const auto next_random = [&seed](unsigned bound)
+  {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % bound;
+  };
+  for (int id = 0; id < 200; ++id)
+  {
+    string text;
+    const unsigned length = 1 + next_random(6);
+    for (unsigned i = 0; i < length; ++i)
+    {
+      text += words[next_random(1 + next_random(words.size()))] + " and "s;
+    }
+    const DocumentStatus status =
+        id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+    const vector<int> ratings = {static_cast<int>(next_random(4))};
+    server.AddDocument(id * 7, text, status, ratings);
+    sharded_server.AddDocument(id * 7, text, status, ratings);
+  }
+  for (int id = 0; id < 1400; id += 91)
+  {
+    server.RemoveDocument(id);
+    sharded_server.RemoveDocument(id);
+  }
+  ASSERT_EQUAL(sharded_server.GetDocumentCount(), server.GetDocumentCount());
+
+  const auto assert_equal_documents = [](const vector<Document> &documents,
+                                         const vector<Document> &expected,
+                                         const string &hint)
+  {
+    ASSERT_EQUAL_HINT(documents.size(), expected.size(), hint);
+    for (size_t i = 0; i < documents.size(); ++i)
+    {
+      ASSERT_EQUAL_HINT(documents[i].id, expected[i].id, hint);
+      ASSERT_HINT(abs(documents[i].relevance - expected[i].relevance) < EPSILON, hint);
+    }
+  };
+  const auto is_odd = [](int id, DocumentStatus, int) { return id % 2 == 1; };
+  QueryOptions options;
+  options.limit = 7;
+  options.offset = 3;
+  for (const string &query : {"cat"s, "dog bird -fish"s, "city tail collar eyes"s,
+                              "eyes unknown"s, "and"s})
+  {
+    assert_equal_documents(sharded_server.FindTopDocuments(query),
+                           server.FindTopDocuments(query), query);
+    assert_equal_documents(sharded_server.FindTopDocuments(query, options),
+                           server.FindTopDocuments(query, options), query);
+    assert_equal_documents(sharded_server.FindTopDocuments(query, DocumentStatus::BANNED),
+                           server.FindTopDocuments(query, DocumentStatus::BANNED), query);
+    assert_equal_documents(sharded_server.FindTopDocuments(query, is_odd),
+                           server.FindTopDocuments(query, is_odd), query);
+  }
+
+  for (const int id : {7, 14, 700})
+  {
+    const auto [words, status] = sharded_server.MatchDocument("cat dog -fish"s, id);
+    const auto [expected_words, expected_status] = server.MatchDocument("cat dog -fish"s, id);
+    ASSERT_EQUAL(words, expected_words);
+    ASSERT_EQUAL(status, expected_status);
+  }
+
+  ASSERT_CODE
+  sharded_server.FindTopDocuments("cat --dog"s);
+  THROWS(invalid_argument)
+  ASSERT_CODE
+  sharded_server.AddDocument(-1, "cat"s, DocumentStatus::ACTUAL, {});
+  THROWS(invalid_argument)
+}
+
+// Тест проверяет поиск документов со всеми словами запроса (ALL_WORDS)
+// и с обязательными словами +слово
+void TestConjunctiveQueries()
+{
+  const vector<string> words = {"cat"s, "dog"s, "bird"s, "fish"s, "city"s, "tail"s};
+  SearchServer server("and"s);
+  unsigned seed = 5;
+  const auto next_random = [&seed](unsigned bound)
+  {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % bound;
+  };
+  for (int id = 0; id < 400; ++id)
+  {
+    string text;
+    const unsigned length = 1 + next_random(5);
+    for (unsigned i = 0; i < length; ++i)
+    {
+      text += words[next_random(1 + next_random(words.size()))] + " and "s;
+    }
+    server.AddDocument(id, text, id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL,
+                       {static_cast<int>(next_random(5))});
+  }
+
+  // Ожидаемая выдача: обычный поиск, из которого оставлены документы
+  // со всеми словами required
+  const auto find_expected = [&server](const string &query, const vector<string> &required,
+                                       DocumentStatus status, size_t limit)
+  {
+    QueryOptions all_documents;
+    all_documents.limit = 1000;
+    vector<Document> expected;
+    for (const Document &document : server.FindTopDocuments(query, status, all_documents))
+    {
+      const auto [matched_words, _] = server.MatchDocument(query, document.id);
+      if (all_of(required.begin(), required.end(),
+                 [&matched_words = matched_words](const string &word)
+                 { return count(matched_words.begin(), matched_words.end(), word) > 0; }) &&
+          expected.size() < limit)
+      {
+        expected.push_back(document);
+      }
+    }
+    return expected;
+  };
+  const auto assert_equal_documents = [](const vector<Document> &documents,
+                                         const vector<Document> &expected,
+                                         const string &hint)
+  {
+    ASSERT_EQUAL_HINT(documents.size(), expected.size(), hint);
+    for (size_t i = 0; i < documents.size(); ++i)
+    {
+      ASSERT_EQUAL_HINT(documents[i].id, expected[i].id, hint);
+      ASSERT_EQUAL_HINT(documents[i].relevance, expected[i].relevance, hint);
+    }
+  };
+
+  QueryOptions all_words;
+  all_words.limit = 10;
+  all_words.match = MatchMode::ALL_WORDS;
+  for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED})
+  {
+    const vector<Document> expected =
+        find_expected("cat city -tail"s, {"cat"s, "city"s}, status, 10);
+    ASSERT(!expected.empty());
+    assert_equal_documents(server.FindTopDocuments("cat city -tail"s, status, all_words),
+                           expected, "ALL_WORDS"s);
+    assert_equal_documents(
+        server.FindTopDocuments(execution::par, "cat city -tail"s, status, all_words),
+        expected, "ALL_WORDS par"s);
+
+    QueryOptions limit;
+    limit.limit = 10;
+    assert_equal_documents(server.FindTopDocuments("cat +city fish -tail"s, status, limit),
+                           find_expected("cat city fish -tail"s, {"city"s}, status, 10),
+                           "+city"s);
+  }
+
+  // Отсутствующее в документах обязательное слово не оставляет ничего
+  ASSERT(server.FindTopDocuments("cat +unknown"s).empty());
+  ASSERT(server.FindTopDocuments("cat unknown"s, all_words).empty());
+  ASSERT(!server.FindTopDocuments("cat unknown"s).empty());
+
+  server.SetPostingListEncoding(PostingListEncoding::COMPRESSED);
+  assert_equal_documents(
+      server.FindTopDocuments("cat city -tail"s, DocumentStatus::ACTUAL, all_words),
+      find_expected("cat city -tail"s, {"cat"s, "city"s}, DocumentStatus::ACTUAL, 10),
+      "ALL_WORDS compressed"s);
+
+  server.AddDocument(1000, "cat dog"s, DocumentStatus::ACTUAL, {});
+  {
+    const auto [words, status] = server.MatchDocument("+cat dog fish"s, 1000);
+    ASSERT_EQUAL(words, (vector<string_view>{"cat"sv, "dog"sv}));
+  }
+  {
+    const auto [words, status] = server.MatchDocument(execution::par, "cat +fish"s, 1000);
+    ASSERT(words.empty());
+  }
+  ASSERT_CODE
+  server.FindTopDocuments("cat +"s);
+  THROWS(invalid_argument)
+}
+
+// Тест проверяет, что поиск с отсечением (MaxScore) возвращает ту же выдачу,
+// что и полный перебор, в том числе для сжатых списков вхождений
+void TestPrunedRetrievalMatchesExhaustive()
+{
+  const vector<string> words = {"cat"s, "dog"s, "bird"s, "fish"s, "city"s,
+                                "tail"s, "collar"s, "eyes"s, "white"s, "black"s};
+  SearchServer server("and"s);
+  unsigned seed = 42;
+  const auto next_random = [&seed](unsigned bound)
+  {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % bound;
+  };
+  for (int id = 0; id < 600; ++id)
+  {
+    string text;
+    const unsigned length = 1 + next_random(8);
+    for (unsigned i = 0; i < length; ++i)
+    {
+      // Редкие слова из конца списка встречаются реже частых
+      text += words[next_random(1 + next_random(words.size()))] + " and "s;
+    }
+    server.AddDocument(id * 3, text, DocumentStatus::ACTUAL,
+                       {static_cast<int>(next_random(10))});
+  }
+  for (int id = 0; id < 1800; id += 21)
+  {
+    server.RemoveDocument(id);
+  }
+
+  const vector<string> queries = {"cat"s, "black white"s, "cat dog bird fish"s,
+                                  "collar eyes -cat"s, "city tail white -dog -fish"s,
+                                  "cat dog bird fish city tail collar eyes white black"s};
+  const auto check = [&server, &queries]
+  {
+    for (const string &query : queries)
+    {
+      for (const size_t limit : {1, 5, 50})
+      {
+        QueryOptions exhaustive;
+        exhaustive.limit = limit;
+        exhaustive.offset = 2;
+        QueryOptions pruned = exhaustive;
+        pruned.mode = RetrievalMode::PRUNED;
+        const auto is_odd_rating = [](int, DocumentStatus, int rating)
+        { return rating % 2 == 1; };
+
+        const vector<Document> expected = server.FindTopDocuments(query, exhaustive);
+        const vector<Document> documents = server.FindTopDocuments(query, pruned);
+        ASSERT_EQUAL_HINT(documents.size(), expected.size(), query);
+        for (size_t i = 0; i < documents.size(); ++i)
+        {
+          ASSERT_EQUAL_HINT(documents[i].id, expected[i].id, query);
+          ASSERT_EQUAL_HINT(documents[i].relevance, expected[i].relevance, query);
+        }
+
+        const vector<Document> expected_odd =
+            server.FindTopDocuments(query, is_odd_rating, exhaustive);
+        const vector<Document> documents_odd =
+            server.FindTopDocuments(query, is_odd_rating, pruned);
+        ASSERT_EQUAL_HINT(documents_odd.size(), expected_odd.size(), query);
+        for (size_t i = 0; i < documents_odd.size(); ++i)
+        {
+          ASSERT_EQUAL_HINT(documents_odd[i].id, expected_odd[i].id, query);
+        }
+      }
+    }
+  };
+  check();
+  server.SetPostingListEncoding(PostingListEncoding::COMPRESSED);
+  check();
+
+  // Пустая страница не должна обращаться к худшему документу пустой кучи
+  QueryOptions empty_page{0, 0};
+  empty_page.mode = RetrievalMode::PRUNED;
+  ASSERT(server.FindTopDocuments("cat dog"s, empty_page).empty());
+  ASSERT(server.FindTopDocuments("cat dog"s, [](int, DocumentStatus, int)
+                                 { return true; },
+                                 empty_page)
+             .empty());
+  ASSERT(server.FindTopDocuments(execution::par, "cat dog"s, empty_page).empty());
+}
+
 // Тест проверяет, что метод MatchDocument возвращает именно те слова,
 // которые пересекаются в документе и в запросе,
 // и то, что если документ содержит минус-слово в из запроса, метод возвращает
@@ -250,21 +1278,21 @@ void TestMatchDocumentReturnsExpectedWords()
 {
   SearchServer server("in the"s);
 
-  vector<string> expected_words;
+  vector<string_view> expected_words;
 
   server.AddDocument(0, "cat in the city"s, DocumentStatus::ACTUAL, {1, 2, 3});
   const auto [match_words_1, status_1] = server.MatchDocument("cat"s, 0);
-  expected_words = {"cat"s};
+  expected_words = {"cat"sv};
   ASSERT_EQUAL(match_words_1, expected_words);
   ASSERT_EQUAL(status_1, DocumentStatus::ACTUAL);
 
   const auto [match_words_2, status_2] = server.MatchDocument("cat city"s, 0);
-  expected_words = {"cat"s, "city"s};
+  expected_words = {"cat"sv, "city"sv};
   ASSERT_EQUAL(match_words_2, expected_words);
 
   const auto [match_words_3, status_3] =
       server.MatchDocument("city some other words"s, 0);
-  expected_words = {"city"s};
+  expected_words = {"city"sv};
   ASSERT_EQUAL(match_words_3, expected_words);
 
   const auto [match_words_4, status_4] =
@@ -272,6 +1300,45 @@ void TestMatchDocumentReturnsExpectedWords()
   ASSERT(match_words_4.empty());
 }
 
+// Проверяем, что GetWordFrequencies возвращает TF слов документа без
+// стоп-слов, а для неизвестного документа — пустой словарь
+void TestGetWordFrequencies()
+{
+  SearchServer server("in"s);
+  server.AddDocument(3, "cat in cat hat"s, DocumentStatus::ACTUAL, {});
+
+  const map<string_view, double> &word_freqs = server.GetWordFrequencies(3);
+  ASSERT_EQUAL(word_freqs.size(), 2);
+  ASSERT(abs(word_freqs.at("cat"sv) - 2.0 / 3.0) < EPSILON);
+  ASSERT(abs(word_freqs.at("hat"sv) - 1.0 / 3.0) < EPSILON);
+
+  ASSERT(server.GetWordFrequencies(4).empty());
+}
+
+// Проверяем, что копия сервера не ссылается на словарь оригинала:
+// поиск, сопоставление и частоты слов работают после его уничтожения
+void TestCopiedServerOutlivesOriginal()
+{
+  auto original = make_unique<SearchServer>("and"s);
+  original->AddDocument(1, "curly cat and fluffy tail"s, DocumentStatus::ACTUAL, {1});
+  original->AddDocument(2, "groomed dog"s, DocumentStatus::ACTUAL, {2});
+  original->GetWordFrequencies(1);
+  SearchServer copy = *original;
+  SearchServer assigned;
+  assigned = *original;
+  original.reset();
+
+  for (SearchServer *server : {&copy, &assigned})
+  {
+    const auto [words, status] = server->MatchDocument("curly dog tail"s, 1);
+    ASSERT_EQUAL(words, (vector<string_view>{"curly"sv, "tail"sv}));
+    const map<string_view, double> &word_freqs = server->GetWordFrequencies(1);
+    ASSERT_EQUAL(word_freqs.size(), 4);
+    ASSERT(abs(word_freqs.at("curly"sv) - 0.25) < EPSILON);
+    ASSERT_EQUAL(server->FindTopDocuments("groomed"s).size(), 1);
+  }
+}
+
 void TestSortingByRelevanceAndByRating()
 {
   // Проверяем, что выдача отсортирована по убыванию релевантности
@@ -314,6 +1381,131 @@ void TestSortingByRelevanceAndByRating()
   }
 }
 
+// Проверяем, что из большого числа найденных документов в выдачу попадают
+// лучшие MAX_RESULT_DOCUMENT_COUNT, а при полном равенстве — с меньшими ID
+void TestTopDocumentsSelection()
+{
+  SearchServer server;
+  for (int i = 0; i < 100; ++i)
+  {
+    server.AddDocument(i, "cat"s, DocumentStatus::ACTUAL, {i % 4});
+  }
+  server.AddDocument(100, "cat dog"s, DocumentStatus::ACTUAL, {0});
+
+  const vector<Document> documents = server.FindTopDocuments("cat dog"s);
+  ASSERT_EQUAL(documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+  ASSERT_EQUAL(documents.at(0).id, 100);
+  const vector<int> expected_ids = {3, 7, 11, 15};
+  for (size_t i = 0; i < expected_ids.size(); ++i)
+  {
+    ASSERT_EQUAL(documents.at(i + 1).id, expected_ids.at(i));
+  }
+
+  TopDocuments top_documents(2);
+  top_documents.Add({1, 0.5, 1});
+  top_documents.Add({2, 0.9, 1});
+  top_documents.Add({3, 0.1, 9});
+  top_documents.Add({4, 0.5 + EPSILON / 2, 2});
+  ASSERT(top_documents.IsFull());
+  ASSERT_EQUAL(top_documents.GetWorst().id, 4);
+  const vector<Document> top = top_documents.Extract();
+  ASSERT_EQUAL(top.size(), 2);
+  ASSERT_EQUAL(top.at(0).id, 2);
+  ASSERT_EQUAL(top.at(1).id, 4);
+}
+
+// Проверяем, что limit и offset выдают нужную страницу общей выдачи
+void TestQueryOptionsLimitAndOffset()
+{
+  SearchServer server;
+  for (int i = 0; i < 12; ++i)
+  {
+    server.AddDocument(i, "cat"s, DocumentStatus::ACTUAL, {i});
+  }
+  server.AddDocument(12, "cat"s, DocumentStatus::BANNED, {100});
+
+  const vector<Document> all_documents =
+      server.FindTopDocuments("cat"s, QueryOptions{100, 0});
+  ASSERT_EQUAL(all_documents.size(), 12);
+  ASSERT_EQUAL(all_documents.at(0).id, 11);
+
+  const auto pages = Paginate(all_documents, 5);
+  size_t offset = 0;
+  for (auto page = pages.begin(); page != pages.end(); ++page)
+  {
+    const vector<Document> documents =
+        server.FindTopDocuments("cat"s, QueryOptions{5, offset});
+    ASSERT_EQUAL(documents.size(), page->size());
+    auto expected = page->begin();
+    for (const Document &document : documents)
+    {
+      ASSERT_EQUAL(document.id, expected->id);
+      ++expected;
+    }
+    offset += 5;
+  }
+
+  ASSERT(server.FindTopDocuments("cat"s, QueryOptions{5, 12}).empty());
+  ASSERT(server.FindTopDocuments("cat"s, QueryOptions{0, 0}).empty());
+  ASSERT_EQUAL(server.FindTopDocuments("cat"s, QueryOptions{}).size(),
+               static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+  ASSERT_EQUAL(server.FindTopDocuments(
+                         "cat"s, QueryOptions{numeric_limits<size_t>::max(), 3})
+                   .size(),
+               9);
+
+  const vector<Document> banned =
+      server.FindTopDocuments("cat"s, DocumentStatus::BANNED, QueryOptions{1, 0});
+  ASSERT_EQUAL(banned.size(), 1);
+  ASSERT_EQUAL(banned.at(0).id, 12);
+
+  const vector<Document> odd = server.FindTopDocuments(
+      "cat"s, [](const int id, const auto &, const auto &)
+      { return id % 2 == 1; },
+      QueryOptions{2, 1});
+  ASSERT_EQUAL(odd.size(), 2);
+  ASSERT_EQUAL(odd.at(0).id, 9);
+  ASSERT_EQUAL(odd.at(1).id, 7);
+}
+
+// Проверяем, что аккумулятор релевантностей полностью очищается между
+// запросами, в том числе к серверам разного размера
+void TestScoreAccumulatorReuse()
+{
+  ScoreAccumulator accumulator;
+  accumulator.Reset(4);
+  accumulator.Add(2, 0.5);
+  accumulator.Add(0, 0.0);
+  accumulator.Add(2, 0.25);
+  accumulator.Exclude(3);
+  accumulator.Add(3, 1.0);
+  map<int, double> scores;
+  accumulator.ForEachScored([&scores](int document_index, double relevance)
+                            { scores[document_index] = relevance; });
+  ASSERT_EQUAL(scores, (map<int, double>{{0, 0.0}, {2, 0.75}}));
+
+  accumulator.Reset(2);
+  ASSERT(!accumulator.IsExcluded(3));
+  accumulator.Add(1, 1.0);
+  scores.clear();
+  accumulator.ForEachScored([&scores](int document_index, double relevance)
+                            { scores[document_index] = relevance; });
+  ASSERT_EQUAL(scores, (map<int, double>{{1, 1.0}}));
+
+  SearchServer big_server;
+  for (int i = 0; i < 50; ++i)
+  {
+    big_server.AddDocument(i, "cat dog"s, DocumentStatus::ACTUAL, {i});
+  }
+  SearchServer small_server;
+  small_server.AddDocument(7, "cat"s, DocumentStatus::ACTUAL, {});
+
+  ASSERT_EQUAL(big_server.FindTopDocuments("cat -dog"s).size(), 0);
+  ASSERT_EQUAL(small_server.FindTopDocuments("cat"s).size(), 1);
+  ASSERT_EQUAL(big_server.FindTopDocuments("cat"s).at(0).id, 49);
+  ASSERT_EQUAL(small_server.FindTopDocuments("cat"s).size(), 1);
+}
+
 // Проверяем расчёт рейтинга
 void TestCalculateAverageRating()
 {
@@ -444,6 +1636,40 @@ void TestCalculateDocumentRelevance()
   ASSERT(documents.at(1).relevance < EPSILON);
 }
 
+// Проверяем, что TF считается по числу вхождений и длине документа,
+// в том числе для слова, встречающегося больше 65535 раз
+void TestTermFrequencyFromOccurrenceCount()
+{
+  SearchServer server("the"s);
+  server.AddDocument(0, "the cat cat cat dog"s, DocumentStatus::ACTUAL, {});
+  server.AddDocument(1, "bird"s, DocumentStatus::ACTUAL, {});
+
+  // TF слова 'cat' равен 3 / 4, IDF равен log(2 / 1)
+  const vector<Document> documents = server.FindTopDocuments("cat"s);
+  ASSERT_EQUAL(documents.size(), 1);
+  ASSERT(abs(documents.at(0).relevance - 0.75 * log(2.0)) < EPSILON);
+  ASSERT(abs(server.GetWordFrequencies(0).at("cat"sv) - 0.75) < EPSILON);
+
+  // Число вхождений не помещается в 16 бит несжатого списка
+  string text;
+  for (int i = 0; i < 65536; ++i)
+  {
+    text += "a "s;
+  }
+  text += "b"s;
+  server.AddDocument(2, text, DocumentStatus::ACTUAL, {});
+  ASSERT_EQUAL(server.GetDocumentCount(), 3);
+  ASSERT(abs(server.GetWordFrequencies(2).at("a"sv) - 65536.0 / 65537.0) < EPSILON);
+  for (const PostingListEncoding encoding :
+       {PostingListEncoding::COMPRESSED, PostingListEncoding::PLAIN})
+  {
+    server.SetPostingListEncoding(encoding);
+    const vector<Document> a_documents = server.FindTopDocuments("a"s);
+    ASSERT_EQUAL(a_documents.size(), 1);
+    ASSERT(abs(a_documents.at(0).relevance - 65536.0 / 65537.0 * log(3.0)) < EPSILON);
+  }
+}
+
 void TestAddDocumentThrowsExceptionWhenIdIdNegative()
 {
   SearchServer server;
@@ -635,14 +1861,39 @@ void TestSearchServer()
 {
   RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
   RUN_TEST(TestAddDocument);
+  RUN_TEST(TestAddDocuments);
   RUN_TEST(TestAddedDocumentCanBeFound);
+  RUN_TEST(TestDocumentsAddedInAnyIdOrderCanBeFound);
+  RUN_TEST(TestQueryWordsResolvedAgainstDictionary);
+  RUN_TEST(TestExternalDocumentIdsAreTranslated);
+  RUN_TEST(TestStringViewQueriesFromBuffer);
+  RUN_TEST(TestRemoveDocument);
+  RUN_TEST(TestGetDocumentIdSkipsRemovedDocuments);
+  RUN_TEST(TestCompressedPostingLists);
+  RUN_TEST(TestPostingListCursorAndBlockBounds);
+  RUN_TEST(TestGetMemoryStats);
   RUN_TEST(TestExcludeDocumentsWithMinusWordsFromSearchResult);
+  RUN_TEST(TestPredicateIsNotCalledForExcludedDocuments);
   RUN_TEST(TestMatchDocumentReturnsExpectedWords);
+  RUN_TEST(TestParallelMatchDocument);
+  RUN_TEST(TestGetWordFrequencies);
+  RUN_TEST(TestCopiedServerOutlivesOriginal);
   RUN_TEST(TestSortingByRelevanceAndByRating);
+  RUN_TEST(TestTopDocumentsSelection);
+  RUN_TEST(TestQueryOptionsLimitAndOffset);
+  RUN_TEST(TestConjunctiveQueries);
+  RUN_TEST(TestPrunedRetrievalMatchesExhaustive);
+  RUN_TEST(TestScoreAccumulatorReuse);
   RUN_TEST(TestCalculateAverageRating);
   RUN_TEST(TestFilterResultByPredicate);
   RUN_TEST(TestFilterResultByStatus);
+  RUN_TEST(TestFindTopDocumentsByRareStatus);
+  RUN_TEST(TestQueryCache);
+  RUN_TEST(TestPreparedQuery);
+  RUN_TEST(TestParallelFindTopDocuments);
   RUN_TEST(TestCalculateDocumentRelevance);
+  RUN_TEST(TestInverseDocumentFreqFollowsIndexChanges);
+  RUN_TEST(TestTermFrequencyFromOccurrenceCount);
   RUN_TEST(TestAddDocumentThrowsExceptionWhenIdIdNegative);
   RUN_TEST(TestAddDocumentThrowsExceptionWhenIdExists);
   RUN_TEST(TestAddDocumentThrowsExceptionIfDocumentContainsInvalidWords);
@@ -651,6 +1902,8 @@ void TestSearchServer()
   RUN_TEST(TestGetDocumentIndexCanThrowsOutOfRangeException);
   RUN_TEST(TestPaginateContainer);
   RUN_TEST(TestRemoveOldRequestsFromQueue);
+  RUN_TEST(TestProcessQueries);
+  RUN_TEST(TestShardedSearchServer);
 }
 
 // --------- Окончание модульных тестов поисковой системы -----------
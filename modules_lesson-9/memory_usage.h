@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Приблизительный объём динамической памяти, занимаемой контейнерами.
+// Узел std::map, помимо значения, хранит цвет и три указателя
+const std::size_t MAP_NODE_OVERHEAD = 4 * sizeof(void *);
+
+template <typename T>
+std::size_t GetMemoryUsage(const std::vector<T> &values)
+{
+    return values.capacity() * sizeof(T);
+}
+
+inline std::size_t GetMemoryUsage(const std::vector<bool> &values)
+{
+    return values.capacity() / 8;
+}
+
+inline std::size_t GetMemoryUsage(const std::string &value)
+{
+    // Короткие строки хранятся внутри объекта std::string
+    return value.capacity() < sizeof(std::string) ? 0 : value.capacity() + 1;
+}
+
+template <typename Key, typename Value, typename Compare>
+std::size_t GetMemoryUsage(const std::map<Key, Value, Compare> &values)
+{
+    return values.size() * (MAP_NODE_OVERHEAD + sizeof(std::pair<const Key, Value>));
+}
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "posting_list.h"
+#include "memory_usage.h"
+
+void WriteVarint(std::uint32_t value, std::vector<std::uint8_t> &bytes)
+{
+    while (value >= 0x80)
+    {
+        bytes.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::uint32_t ReadVarint(const std::uint8_t *&data)
+{
+    std::uint32_t value = 0;
+    for (int shift = 0;; shift += 7)
+    {
+        const std::uint8_t byte = *data++;
+        value |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+        if (byte < 0x80)
+        {
+            return value;
+        }
+    }
+}
+
+PostingList::PostingList(PostingListEncoding encoding)
+    : encoding_(encoding) {}
+
+void PostingList::Add(int document_index, TermCount count, int document_word_count)
+{
+    const double term_freq = count / static_cast<double>(document_word_count);
+    if (size_ % BLOCK_SIZE == 0)
+    {
+        block_bounds_.push_back({document_index, term_freq});
+    }
+    else
+    {
+        block_bounds_.back().last_document_index = document_index;
+        block_bounds_.back().max_term_freq =
+            std::max(block_bounds_.back().max_term_freq, term_freq);
+    }
+    Append(document_index, count);
+    max_term_freq_ = std::max(max_term_freq_, term_freq);
+}
+
+void PostingList::Append(int document_index, TermCount count)
+{
+    if (encoding_ == PostingListEncoding::PLAIN)
+    {
+        document_indexes_.push_back(document_index);
+        if (count >= LARGE_COUNT)
+        {
+            large_counts_.emplace_back(size_, count);
+            count = LARGE_COUNT;
+        }
+        counts_.push_back(static_cast<std::uint16_t>(count));
+    }
+    else
+    {
+        if (size_ % BLOCK_SIZE == 0)
+        {
+            blocks_.push_back({document_index, bytes_.size()});
+        }
+        else
+        {
+            WriteVarint(document_index - last_document_index_, bytes_);
+        }
+        WriteVarint(count, bytes_);
+    }
+    last_document_index_ = document_index;
+    ++size_;
+}
+
+std::size_t PostingList::Size() const
+{
+    return size_;
+}
+
+bool PostingList::Empty() const
+{
+    return size_ == 0;
+}
+
+std::size_t PostingList::GetMemoryUsage() const
+{
+    return ::GetMemoryUsage(document_indexes_) + ::GetMemoryUsage(counts_) +
+           ::GetMemoryUsage(large_counts_) + ::GetMemoryUsage(blocks_) + ::GetMemoryUsage(bytes_) +
+           ::GetMemoryUsage(block_bounds_);
+}
+
+double PostingList::GetMaxTermFreq() const
+{
+    return max_term_freq_;
+}
+
+PostingListEncoding PostingList::GetEncoding() const
+{
+    return encoding_;
+}
+
+void PostingList::SetEncoding(PostingListEncoding encoding)
+{
+    if (encoding == encoding_)
+    {
+        return;
+    }
+    PostingList reencoded(encoding);
+    ForEachPosting([&reencoded](int document_index, TermCount count)
+                   { reencoded.Append(document_index, count); });
+    // Блоки обеих кодировок состоят из одних и тех же вхождений
+    reencoded.max_term_freq_ = max_term_freq_;
+    reencoded.block_bounds_ = std::move(block_bounds_);
+    reencoded.ShrinkToFit();
+    *this = std::move(reencoded);
+}
+
+void PostingList::RenumberDocuments(const std::vector<int> &new_indexes,
+                                    const std::vector<int> &document_word_counts)
+{
+    PostingList renumbered(encoding_);
+    ForEachPosting([&](int document_index, TermCount count)
+                   {
+                       const int new_index = new_indexes[document_index];
+                       if (new_index >= 0)
+                       {
+                           renumbered.Add(new_index, count, document_word_counts[new_index]);
+                       }
+                   });
+    renumbered.ShrinkToFit();
+    *this = std::move(renumbered);
+}
+
+std::size_t PostingList::DecodeBlock(std::size_t block, int *document_indexes,
+                                     TermCount *counts) const
+{
+    const std::size_t size = std::min(BLOCK_SIZE, size_ - block * BLOCK_SIZE);
+    const std::uint8_t *data = bytes_.data() + blocks_[block].offset;
+    int document_index = blocks_[block].first_document_index;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        if (i > 0)
+        {
+            document_index += static_cast<int>(ReadVarint(data));
+        }
+        document_indexes[i] = document_index;
+        counts[i] = static_cast<TermCount>(ReadVarint(data));
+    }
+    return size;
+}
+
+void PostingList::ShrinkToFit()
+{
+    document_indexes_.shrink_to_fit();
+    counts_.shrink_to_fit();
+    large_counts_.shrink_to_fit();
+
+    blocks_.shrink_to_fit();
+    bytes_.shrink_to_fit();
+    block_bounds_.shrink_to_fit();
+}
+
+// PostingList::Cursor
+
+PostingList::Cursor::Cursor(const PostingList &postings)
+    : postings_(&postings)
+{
+    if (IsPlain())
+    {
+        block_size_ = postings.size_;
+    }
+    else if (!postings.blocks_.empty())
+    {
+        LoadBlock(0);
+    }
+}
+
+bool PostingList::Cursor::IsEnd() const
+{
+    return position_ == block_size_;
+}
+
+int PostingList::Cursor::GetDocumentIndex() const
+{
+    return IsPlain() ? postings_->document_indexes_[position_]
+                     : document_indexes_[position_];
+}
+
+TermCount PostingList::Cursor::GetCount() const
+{
+    return IsPlain() ? postings_->GetPlainCount(position_) : counts_[position_];
+}
+
+void PostingList::Cursor::Next()
+{
+    ++position_;
+    if (position_ == block_size_ && !IsPlain() &&
+        block_ + 1 < postings_->blocks_.size())
+    {
+        LoadBlock(block_ + 1);
+    }
+}
+
+void PostingList::Cursor::SkipTo(int document_index)
+{
+    if (IsEnd() || GetDocumentIndex() >= document_index)
+    {
+        return;
+    }
+    if (IsPlain())
+    {
+        // Галопирующий поиск: короткие пропуски дешевле двоичного поиска по хвосту
+        const int *document_indexes = postings_->document_indexes_.data();
+        std::size_t step = 1;
+        while (position_ + step < block_size_ &&
+               document_indexes[position_ + step] < document_index)
+        {
+            step *= 2;
+        }
+        position_ = std::lower_bound(document_indexes + position_ + step / 2,
+                                     document_indexes + std::min(position_ + step, block_size_),
+                                     document_index) -
+                    document_indexes;
+        return;
+    }
+    SkipBlocksTo(document_index);
+    if (bound_block_ == postings_->block_bounds_.size())
+    {
+        // Все документы списка меньше искомого
+        position_ = block_size_;
+        return;
+    }
+    if (bound_block_ != block_)
+    {
+        LoadBlock(bound_block_);
+    }
+    position_ = std::lower_bound(document_indexes_ + position_,
+                                 document_indexes_ + block_size_, document_index) -
+                document_indexes_;
+}
+
+void PostingList::Cursor::SkipBlocksTo(int document_index)
+{
+    const std::vector<BlockBound> &bounds = postings_->block_bounds_;
+    if (bound_block_ < bounds.size() &&
+        bounds[bound_block_].last_document_index < document_index)
+    {
+        bound_block_ = std::lower_bound(bounds.begin() + bound_block_ + 1, bounds.end(),
+                                        document_index,
+                                        [](const BlockBound &bound, int index)
+                                        { return bound.last_document_index < index; }) -
+                       bounds.begin();
+    }
+}
+
+double PostingList::Cursor::GetBlockMaxTermFreq() const
+{
+    const std::vector<BlockBound> &bounds = postings_->block_bounds_;
+    return bound_block_ < bounds.size() ? bounds[bound_block_].max_term_freq : 0.0;
+}
+
+int PostingList::Cursor::GetBlockLastDocumentIndex() const
+{
+    const std::vector<BlockBound> &bounds = postings_->block_bounds_;
+    return bound_block_ < bounds.size() ? bounds[bound_block_].last_document_index
+                                        : std::numeric_limits<int>::max();
+}
+
+bool PostingList::Cursor::IsPlain() const
+{
+    return postings_->encoding_ == PostingListEncoding::PLAIN;
+}
+
+void PostingList::Cursor::LoadBlock(std::size_t block)
+{
+    block_ = block;
+    bound_block_ = std::max(bound_block_, block);
+    block_size_ = postings_->DecodeBlock(block, document_indexes_, counts_);
+    position_ = 0;
+}
\ No newline at end of file
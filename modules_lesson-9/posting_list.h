@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Число вхождений слова в документ. Вмещает любое число слов документа;
+// списки хранят его компактнее, см. PostingList
+using TermCount = std::uint32_t;
+
+enum class PostingListEncoding
+{
+    // Номера документов и 16-битные числа вхождений в двух непрерывных
+    // массивах. Редкие большие числа хранятся отдельно
+    PLAIN,
+    // Блоки по BLOCK_SIZE вхождений: разности номеров документов и
+    // числа вхождений, упакованные переменным числом байт
+    COMPRESSED,
+};
+
+/**
+ * Список вхождений слова: отсортированные по возрастанию внутренние номера
+ * документов и число вхождений слова в каждый из них
+ */
+class PostingList
+{
+public:
+    static constexpr std::size_t BLOCK_SIZE = 128;
+
+    explicit PostingList(PostingListEncoding encoding = PostingListEncoding::PLAIN);
+
+    /**
+     * Дописывает число вхождений слова в документ из document_word_count слов.
+     * Номера документов выдаются по возрастанию, поэтому document_index
+     * больше последнего добавленного
+     */
+    void Add(int document_index, TermCount count, int document_word_count);
+
+    std::size_t Size() const;
+
+    bool Empty() const;
+
+    // Объём динамической памяти, занимаемой списком
+    std::size_t GetMemoryUsage() const;
+
+    /**
+     * Верхняя граница TF слова по документам списка. После удаления
+     * документов не уменьшается и остаётся верхней границей
+     */
+    double GetMaxTermFreq() const;
+
+    PostingListEncoding GetEncoding() const;
+
+    void SetEncoding(PostingListEncoding encoding);
+
+    /**
+     * Перенумеровывает документы по таблице new_indexes.
+     * Документы, для которых там записано -1, удаляются из списка.
+     * document_word_counts - длины документов по новым номерам, по ним
+     * пересчитываются границы TF блоков
+     */
+    void RenumberDocuments(const std::vector<int> &new_indexes,
+                           const std::vector<int> &document_word_counts);
+
+    /**
+     * Вызывает callback(document_index, count) для каждого вхождения.
+     * Сжатый список декодируется поблочно прямо в цикл вызовов
+     */
+    template <typename Callback>
+    void ForEachPosting(Callback callback) const;
+
+    /**
+     * Вызывает callback(document_index, count) для вхождений документов
+     * из [first_document_index, last_document_index). Начало отрезка
+     * ищется по границам блоков
+     */
+    template <typename Callback>
+    void ForEachPostingInRange(int first_document_index, int last_document_index,
+                               Callback callback) const;
+
+    class Cursor;
+
+private:
+    struct Block
+    {
+        int first_document_index;
+        // Смещение первого байта блока в bytes_
+        std::size_t offset;
+    };
+
+    // Границы блока из BLOCK_SIZE вхождений, одинаковые для обеих кодировок
+    struct BlockBound
+    {
+        int last_document_index;
+        double max_term_freq;
+    };
+
+    PostingListEncoding encoding_;
+    std::size_t size_ = 0;
+    int last_document_index_ = -1;
+    double max_term_freq_ = 0.0;
+    std::vector<BlockBound> block_bounds_;
+
+    // Числа вхождений от LARGE_COUNT и больше записаны в counts_ как
+    // LARGE_COUNT, а сами хранятся в large_counts_ по позиции в списке
+    static constexpr std::uint16_t LARGE_COUNT = std::numeric_limits<std::uint16_t>::max();
+
+    std::vector<int> document_indexes_;
+    std::vector<std::uint16_t> counts_;
+    std::vector<std::pair<std::size_t, TermCount>> large_counts_;
+
+    std::vector<Block> blocks_;
+    std::vector<std::uint8_t> bytes_;
+
+    // Дописывает вхождение, не трогая границ TF
+    void Append(int document_index, TermCount count);
+
+    // Число вхождений на позиции position несжатого списка
+    TermCount GetPlainCount(std::size_t position) const;
+
+    std::size_t DecodeBlock(std::size_t block, int *document_indexes,
+                            TermCount *counts) const;
+
+    void ShrinkToFit();
+};
+
+/**
+ * Курсор для обхода списка по возрастанию номеров документов с пропуском
+ * вперёд. Сжатый список декодируется по одному блоку, пропуск ищет нужный
+ * блок по границам блоков, не декодируя промежуточные.
+ * Границы блока можно узнать и без декодирования: SkipBlocksTo сдвигает
+ * только указатель на границы, а SkipTo затем декодирует найденный блок
+ */
+class PostingList::Cursor
+{
+public:
+    explicit Cursor(const PostingList &postings);
+
+    bool IsEnd() const;
+
+    // Текущее вхождение. Only if not IsEnd()
+    int GetDocumentIndex() const;
+
+    TermCount GetCount() const;
+
+    void Next();
+
+    // Переходит к первому вхождению с номером документа не меньше document_index
+    void SkipTo(int document_index);
+
+    // Переходит к границам блока, в котором может быть document_index
+    void SkipBlocksTo(int document_index);
+
+    // Наибольший TF в блоке границ, 0 за последним блоком
+    double GetBlockMaxTermFreq() const;
+
+    // Последний документ блока границ, INT_MAX за последним блоком
+    int GetBlockLastDocumentIndex() const;
+
+private:
+    const PostingList *postings_;
+    // Блок, границы которого рассматриваются, не раньше декодированного
+    std::size_t bound_block_ = 0;
+    // Для несжатого списка блоком считается весь список
+    std::size_t block_ = 0;
+    std::size_t block_size_ = 0;
+    std::size_t position_ = 0;
+    int document_indexes_[BLOCK_SIZE];
+    TermCount counts_[BLOCK_SIZE];
+
+    bool IsPlain() const;
+
+    void LoadBlock(std::size_t block);
+};
+
+// templates IMPL
+
+inline TermCount PostingList::GetPlainCount(std::size_t position) const
+{
+    if (counts_[position] != LARGE_COUNT)
+    {
+        return counts_[position];
+    }
+    return std::lower_bound(large_counts_.begin(), large_counts_.end(),
+                            std::pair<std::size_t, TermCount>{position, 0})
+        ->second;
+}
+
+template <typename Callback>
+void PostingList::ForEachPostingInRange(int first_document_index, int last_document_index,
+                                        Callback callback) const
+{
+    if (encoding_ == PostingListEncoding::PLAIN)
+    {
+        for (auto it = std::lower_bound(document_indexes_.begin(), document_indexes_.end(),
+                                        first_document_index);
+             it != document_indexes_.end() && *it < last_document_index; ++it)
+        {
+            callback(*it, GetPlainCount(it - document_indexes_.begin()));
+        }
+        return;
+    }
+    int document_indexes[BLOCK_SIZE];
+    TermCount counts[BLOCK_SIZE];
+    std::size_t block =
+        std::lower_bound(block_bounds_.begin(), block_bounds_.end(), first_document_index,
+                         [](const BlockBound &bound, int index)
+                         { return bound.last_document_index < index; }) -
+        block_bounds_.begin();
+    for (; block < blocks_.size() && blocks_[block].first_document_index < last_document_index;
+         ++block)
+    {
+        const std::size_t size = DecodeBlock(block, document_indexes, counts);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            if (first_document_index <= document_indexes[i] &&
+                document_indexes[i] < last_document_index)
+            {
+                callback(document_indexes[i], counts[i]);
+            }
+        }
+    }
+}
+
+template <typename Callback>
+void PostingList::ForEachPosting(Callback callback) const
+{
+    if (encoding_ == PostingListEncoding::PLAIN)
+    {
+        for (std::size_t i = 0; i < document_indexes_.size(); ++i)
+        {
+            callback(document_indexes_[i], GetPlainCount(i));
+        }
+        return;
+    }
+    int document_indexes[BLOCK_SIZE];
+    TermCount counts[BLOCK_SIZE];
+    for (std::size_t block = 0; block < blocks_.size(); ++block)
+    {
+        const std::size_t size = DecodeBlock(block, document_indexes, counts);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            callback(document_indexes[i], counts[i]);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#include <algorithm>
+#include <execution>
+#include <numeric>
+
+#include "process_queries.h"
+
+std::vector<std::vector<Document>> ProcessQueries(
+    const SearchServer &search_server,
+    const std::vector<std::string> &queries)
+{
+    std::vector<std::vector<Document>> documents_lists(queries.size());
+    std::transform(std::execution::par, queries.begin(), queries.end(),
+                   documents_lists.begin(),
+                   [&search_server](const std::string &query)
+                   { return search_server.FindTopDocuments(query); });
+    return documents_lists;
+}
+
+std::vector<Document> ProcessQueriesJoined(
+    const SearchServer &search_server,
+    const std::vector<std::string> &queries)
+{
+    const std::vector<std::vector<Document>> documents_lists =
+        ProcessQueries(search_server, queries);
+
+    // Место выдачи каждого запроса в общей последовательности
+    std::vector<std::size_t> offsets(documents_lists.size());
+    std::transform_exclusive_scan(documents_lists.begin(), documents_lists.end(),
+                                  offsets.begin(), std::size_t{0}, std::plus<>{},
+                                  [](const std::vector<Document> &documents)
+                                  { return documents.size(); });
+    const std::size_t total_size =
+        documents_lists.empty() ? 0 : offsets.back() + documents_lists.back().size();
+
+    std::vector<Document> joined_documents(total_size);
+    std::vector<std::size_t> indexes(documents_lists.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(),
+                  [&](const std::size_t i)
+                  {
+                      std::copy(documents_lists[i].begin(), documents_lists[i].end(),
+                                joined_documents.begin() + offsets[i]);
+                  });
+    return joined_documents;
+}
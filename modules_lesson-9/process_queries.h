@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+/**
+ * Выполняет FindTopDocuments для каждого запроса пакета. Запросы
+ * обрабатываются параллельно, i-й результат соответствует i-му запросу
+ */
+std::vector<std::vector<Document>> ProcessQueries(
+    const SearchServer &search_server,
+    const std::vector<std::string> &queries);
+
+/**
+ * То же, но выдачи всех запросов склеены в одну последовательность
+ * в порядке запросов
+ */
+std::vector<Document> ProcessQueriesJoined(
+    const SearchServer &search_server,
+    const std::vector<std::string> &queries);
@@ -0,0 +1,105 @@
+#include <tuple>
+#include <utility>
+
+#include "query_cache.h"
+#include "memory_usage.h"
+
+bool QueryCache::Key::operator<(const Key &other) const
+{
+    return std::tie(plus_terms, minus_terms, required_terms, inverse_document_freqs,
+                    status, limit, offset) <
+           std::tie(other.plus_terms, other.minus_terms, other.required_terms,
+                    other.inverse_document_freqs, other.status, other.limit, other.offset);
+}
+
+QueryCache::QueryCache(std::size_t max_bytes)
+    : max_bytes_(max_bytes) {}
+
+QueryCache::QueryCache(const QueryCache &other)
+    : max_bytes_(other.GetMaxBytes()) {}
+
+QueryCache &QueryCache::operator=(const QueryCache &other)
+{
+    if (this != &other)
+    {
+        const std::size_t max_bytes = other.GetMaxBytes();
+        const std::lock_guard lock(mutex_);
+        max_bytes_ = max_bytes;
+        bytes_ = 0;
+        hits_ = 0;
+        misses_ = 0;
+        entries_.clear();
+        key_to_entry_.clear();
+    }
+    return *this;
+}
+
+std::optional<std::vector<Document>> QueryCache::Find(const Key &key,
+                                                      std::uint64_t epoch)
+{
+    const std::lock_guard lock(mutex_);
+    SetEpoch(epoch);
+    const auto it = key_to_entry_.find(key);
+    if (it == key_to_entry_.end())
+    {
+        ++misses_;
+        return std::nullopt;
+    }
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->documents;
+}
+
+void QueryCache::Insert(const Key &key, const std::vector<Document> &documents,
+                        std::uint64_t epoch)
+{
+    // Ключ хранится дважды: в записи и в индексе. Узел списка - запись
+    // и два указателя
+    const std::size_t key_bytes = GetMemoryUsage(key.plus_terms) +
+                                  GetMemoryUsage(key.minus_terms) +
+                                  GetMemoryUsage(key.required_terms) +
+                                  GetMemoryUsage(key.inverse_document_freqs);
+    const std::size_t bytes =
+        sizeof(Entry) + 2 * sizeof(void *) + GetMemoryUsage(documents) +
+        MAP_NODE_OVERHEAD + sizeof(std::pair<const Key, std::list<Entry>::iterator>) +
+        2 * key_bytes;
+
+    const std::lock_guard lock(mutex_);
+    if (epoch < epoch_ || bytes > max_bytes_ || key_to_entry_.count(key) > 0)
+    {
+        return;
+    }
+    SetEpoch(epoch);
+    while (bytes_ + bytes > max_bytes_)
+    {
+        key_to_entry_.erase(entries_.back().key);
+        bytes_ -= entries_.back().bytes;
+        entries_.pop_back();
+    }
+    entries_.push_front({key, documents, bytes});
+    key_to_entry_.emplace(key, entries_.begin());
+    bytes_ += bytes;
+}
+
+QueryCache::Stats QueryCache::GetStats() const
+{
+    const std::lock_guard lock(mutex_);
+    return {hits_, misses_, entries_.size(), bytes_};
+}
+
+std::size_t QueryCache::GetMaxBytes() const
+{
+    const std::lock_guard lock(mutex_);
+    return max_bytes_;
+}
+
+void QueryCache::SetEpoch(std::uint64_t epoch)
+{
+    if (epoch != epoch_)
+    {
+        epoch_ = epoch;
+        bytes_ = 0;
+        entries_.clear();
+        key_to_entry_.clear();
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "document.h"
+#include "term_dictionary.h"
+
+/**
+ * Кэш результатов поиска с вытеснением давно не использованных (LRU).
+ * Размер ограничен приблизительным объёмом памяти записей.
+ * Каждая запись помнит эпоху индекса, в которой посчитана: при смене эпохи
+ * кэш целиком сбрасывается. Методы потокобезопасны
+ */
+class QueryCache
+{
+public:
+    // Разобранный запрос: отсортированные ID слов без повторов и страница выдачи
+    struct Key
+    {
+        std::vector<TermId> plus_terms;
+        std::vector<TermId> minus_terms;
+        // Слова, которые должны быть в документе
+        std::vector<TermId> required_terms;
+        // IDF плюс-слов, если они посчитаны не по статистике сервера, иначе пусто
+        std::vector<double> inverse_document_freqs;
+        DocumentStatus status;
+        std::size_t limit;
+        std::size_t offset;
+
+        bool operator<(const Key &other) const;
+    };
+
+    struct Stats
+    {
+        std::size_t hits;
+        std::size_t misses;
+        std::size_t entry_count;
+        std::size_t bytes;
+    };
+
+    explicit QueryCache(std::size_t max_bytes);
+
+    // Копия получает тот же лимит, но начинает с пустого кэша
+    QueryCache(const QueryCache &other);
+
+    QueryCache &operator=(const QueryCache &other);
+
+    std::optional<std::vector<Document>> Find(const Key &key, std::uint64_t epoch);
+
+    void Insert(const Key &key, const std::vector<Document> &documents,
+                std::uint64_t epoch);
+
+    Stats GetStats() const;
+
+private:
+    struct Entry
+    {
+        Key key;
+        std::vector<Document> documents;
+        std::size_t bytes;
+    };
+
+    mutable std::mutex mutex_;
+    std::size_t max_bytes_;
+    std::size_t bytes_ = 0;
+    std::uint64_t epoch_ = 0;
+    std::size_t hits_ = 0;
+    std::size_t misses_ = 0;
+    // Записи от недавно использованных к давно не использованным
+    std::list<Entry> entries_;
+    std::map<Key, std::list<Entry>::iterator> key_to_entry_;
+
+    std::size_t GetMaxBytes() const;
+
+    // Only under lock
+    void SetEpoch(std::uint64_t epoch);
+};
@@ -3,7 +3,7 @@
 RequestQueue::RequestQueue(const SearchServer &search_server)
     : search_server_(search_server) {}
 
-std::vector<Document> RequestQueue::AddFindRequest(const std::string &raw_query,
+std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query,
                                                    const DocumentStatus status)
 {
     // напишите реализацию
@@ -12,7 +12,7 @@ std::vector<Document> RequestQueue::AddFindRequest(const std::string &raw_query,
     return documents;
 }
 
-std::vector<Document> RequestQueue::AddFindRequest(const std::string &raw_query)
+std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query)
 {
     // напишите реализацию
     const std::vector<Document> documents = search_server_.FindTopDocuments(raw_query);
@@ -3,6 +3,7 @@
 #include <vector>
 #include <deque>
 #include <string>
+#include <string_view>
 
 #include "search_server.h"
 
@@ -12,13 +13,13 @@ public:
     explicit RequestQueue(const SearchServer &search_server);
 
     template <typename DocumentPredicate>
-    std::vector<Document> AddFindRequest(const std::string &raw_query,
+    std::vector<Document> AddFindRequest(std::string_view raw_query,
                                          const DocumentPredicate document_predicate);
 
-    std::vector<Document> AddFindRequest(const std::string &raw_query,
+    std::vector<Document> AddFindRequest(std::string_view raw_query,
                                          const DocumentStatus status);
 
-    std::vector<Document> AddFindRequest(const std::string &raw_query);
+    std::vector<Document> AddFindRequest(std::string_view raw_query);
 
     int GetNoResultRequests() const;
 
@@ -44,7 +45,7 @@ private:
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(
-    const std::string &raw_query, DocumentPredicate document_predicate)
+    std::string_view raw_query, DocumentPredicate document_predicate)
 {
     const std::vector<Document> documents = search_server_.FindTopDocuments(raw_query, document_predicate);
     AddQueryResult({documents.empty()});
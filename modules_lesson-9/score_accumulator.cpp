@@ -0,0 +1,46 @@
+#include "score_accumulator.h"
+
+void ScoreAccumulator::Reset(std::size_t document_count)
+{
+    for (const int document_index : touched_documents_)
+    {
+        scores_[document_index] = 0.0;
+        states_[document_index] = State::UNTOUCHED;
+    }
+    touched_documents_.clear();
+    if (scores_.size() < document_count)
+    {
+        scores_.resize(document_count, 0.0);
+        states_.resize(document_count, State::UNTOUCHED);
+    }
+}
+
+void ScoreAccumulator::Add(int document_index, double score)
+{
+    State &state = states_[document_index];
+    if (state == State::EXCLUDED)
+    {
+        return;
+    }
+    if (state == State::UNTOUCHED)
+    {
+        state = State::SCORED;
+        touched_documents_.push_back(document_index);
+    }
+    scores_[document_index] += score;
+}
+
+void ScoreAccumulator::Exclude(int document_index)
+{
+    State &state = states_[document_index];
+    if (state == State::UNTOUCHED)
+    {
+        touched_documents_.push_back(document_index);
+    }
+    state = State::EXCLUDED;
+}
+
+bool ScoreAccumulator::IsExcluded(int document_index) const
+{
+    return states_[document_index] == State::EXCLUDED;
+}
\ No newline at end of file
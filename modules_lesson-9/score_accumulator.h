@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Плотный массив релевантностей, индексируемый внутренним номером документа.
+ * Список затронутых документов позволяет обнулить аккумулятор за время,
+ * пропорциональное числу найденных документов, а не размеру индекса
+ */
+class ScoreAccumulator
+{
+public:
+    /**
+     * Готовит аккумулятор к новому запросу по индексу из document_count документов
+     */
+    void Reset(std::size_t document_count);
+
+    void Add(int document_index, double score);
+
+    /**
+     * Исключает документ из выдачи. Его релевантность больше не учитывается
+     */
+    void Exclude(int document_index);
+
+    bool IsExcluded(int document_index) const;
+
+    /**
+     * Вызывает callback(document_index, relevance) для каждого
+     * неисключённого документа, получившего релевантность
+     */
+    template <typename Callback>
+    void ForEachScored(Callback callback) const;
+
+private:
+    enum class State : std::uint8_t
+    {
+        UNTOUCHED,
+        SCORED,
+        EXCLUDED,
+    };
+
+    std::vector<double> scores_;
+    std::vector<State> states_;
+    std::vector<int> touched_documents_;
+};
+
+// templates IMPL
+
+template <typename Callback>
+void ScoreAccumulator::ForEachScored(Callback callback) const
+{
+    for (const int document_index : touched_documents_)
+    {
+        if (states_[document_index] == State::SCORED)
+        {
+            callback(document_index, scores_[document_index]);
+        }
+    }
+}
\ No newline at end of file
@@ -2,11 +2,25 @@
 #include <cmath>
 #include <algorithm>
 #include <stdexcept>
+#include <future>
+#include <thread>
+#include <utility>
+#include <limits>
+#include <execution>
+#include <atomic>
 
 #include "search_server.h"
+#include "memory_usage.h"
 
 using namespace std::string_literals;
 
+std::size_t GetMaxResultCount(const QueryOptions &options)
+{
+    // Отбираются только документы, попадающие в запрошенную страницу или выше
+    return options.offset + std::min(
+        options.limit, std::numeric_limits<std::size_t>::max() - options.offset);
+}
+
 int ComputeAverageRating(const std::vector<int> &ratings)
 {
     if (ratings.empty())
@@ -17,7 +31,7 @@ int ComputeAverageRating(const std::vector<int> &ratings)
     return sum / static_cast<int>(ratings.size());
 }
 
-bool SearchServer::IsValidWord(const std::string &word)
+bool SearchServer::IsValidWord(std::string_view word)
 {
     return !word.empty() && word.at(0) != '-' &&
            word.at(word.size() - 1) != '-' &&
@@ -29,106 +43,530 @@ bool SearchServer::IsValidWord(const std::string &word)
 // SearchServer
 
 SearchServer::SearchServer(const std::string &stop_words_text)
+    : SearchServer(std::string_view(stop_words_text)) {}
+
+SearchServer::SearchServer(std::string_view stop_words_text)
     : SearchServer(SplitIntoWords(stop_words_text)) {}
 
 SearchServer::SearchServer() : SearchServer(""s) {}
 
-void SearchServer::AddDocument(int document_id, const std::string &document,
+void SearchServer::AddDocument(int document_id, std::string_view document,
                                DocumentStatus status, const std::vector<int> &ratings)
 {
-    if (document_id < 0)
+    CheckNewDocumentId(document_id);
+    const DocumentWords words = ParseDocument(document);
+    const int document_index = static_cast<int>(document_ids_.size());
+    std::vector<std::pair<TermId, TermCount>> &document_terms =
+        document_terms_.emplace_back();
+    for (const auto [word, count] : words.word_counts)
     {
-        throw std::invalid_argument("Document ID is negative"s);
+        const TermId term_id = AddTerm(word);
+        term_postings_[term_id].Add(document_index, count, words.word_count);
+        document_terms.emplace_back(term_id, count);
+        ChangeTermDocumentCount(term_id, 1);
     }
-    if (documents_.count(document_id))
+    std::sort(document_terms.begin(), document_terms.end());
+    document_id_to_index_.emplace(document_id, document_index);
+    document_ids_.push_back(document_id);
+    document_word_counts_.push_back(words.word_count);
+    document_ratings_.push_back(ComputeAverageRating(ratings));
+    document_statuses_.push_back(status);
+    status_document_indexes_[status].push_back(document_index);
+    is_removed_document_.push_back(false);
+    live_documents_.Add();
+    UpdateDocumentCountLog();
+    epoch_ = NextEpoch();
+}
+
+void SearchServer::AddDocuments(const std::vector<NewDocument> &documents)
+{
+    std::set<int> batch_document_ids;
+    for (const NewDocument &document : documents)
     {
-        throw std::invalid_argument(
-            "Search Server already contains document with ID '"s +
-            std::to_string(document_id) + "'"s);
+        CheckNewDocumentId(document.id);
+        if (!batch_document_ids.insert(document.id).second)
+        {
+            throw std::invalid_argument(
+                "Batch contains document with ID '"s +
+                std::to_string(document.id) + "' more than once"s);
+        }
     }
-    const std::vector<std::string> words = SplitIntoWordsNoStop(document);
-    for (const std::string &word : words)
+
+    // Частичный индекс: слово -> номера документов в пакете и число
+    // вхождений слова в них, а также длины документов отрезка
+    struct PartialIndex
     {
-        if (!IsValidWord(word))
+        std::map<std::string_view, std::vector<std::pair<std::size_t, TermCount>>>
+            word_to_document_counts;
+        std::vector<int> document_word_counts;
+    };
+
+    const std::size_t thread_count =
+        std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t chunk_size = (documents.size() + thread_count - 1) / thread_count;
+    std::vector<std::future<PartialIndex>> partial_index_futures;
+    for (std::size_t begin = 0; begin < documents.size(); begin += chunk_size)
+    {
+        const std::size_t end = std::min(begin + chunk_size, documents.size());
+        partial_index_futures.push_back(std::async(
+            std::launch::async,
+            [this, &documents, begin, end]
+            {
+                PartialIndex partial_index;
+                for (std::size_t i = begin; i < end; ++i)
+                {
+                    const DocumentWords words = ParseDocument(documents[i].text);
+                    for (const auto [word, count] : words.word_counts)
+                    {
+                        partial_index.word_to_document_counts[word].emplace_back(i, count);
+                    }
+                    partial_index.document_word_counts.push_back(words.word_count);
+                }
+                return partial_index;
+            }));
+    }
+    // Исключение из любого потока выбрасывается здесь, до изменения индекса
+    std::vector<PartialIndex> partial_indexes;
+    for (std::future<PartialIndex> &future : partial_index_futures)
+    {
+        partial_indexes.push_back(future.get());
+    }
+
+    const int first_index = static_cast<int>(document_ids_.size());
+    for (const PartialIndex &partial_index : partial_indexes)
+    {
+        document_word_counts_.insert(document_word_counts_.end(),
+                                     partial_index.document_word_counts.begin(),
+                                     partial_index.document_word_counts.end());
+    }
+    for (const NewDocument &document : documents)
+    {
+        status_document_indexes_[document.status].push_back(
+            static_cast<int>(document_ids_.size()));
+        document_id_to_index_.emplace(document.id, document_ids_.size());
+        document_ids_.push_back(document.id);
+        document_ratings_.push_back(ComputeAverageRating(document.ratings));
+        document_statuses_.push_back(document.status);
+        is_removed_document_.push_back(false);
+        live_documents_.Add();
+        document_terms_.emplace_back();
+    }
+    // Отрезки пакета идут по порядку, поэтому списки вхождений
+    // дописываются в конец и остаются отсортированными
+    for (const PartialIndex &partial_index : partial_indexes)
+    {
+        for (const auto &[word, document_counts] : partial_index.word_to_document_counts)
         {
-            throw std::invalid_argument("Word '"s + word +
-                                        "' in document is not valid"s);
+            const TermId term_id = AddTerm(word);
+            PostingList &postings = term_postings_[term_id];
+            for (const auto &[position, count] : document_counts)
+            {
+                const int document_index = first_index + static_cast<int>(position);
+                postings.Add(document_index, count, document_word_counts_[document_index]);
+                document_terms_[document_index].emplace_back(term_id, count);
+            }
+            ChangeTermDocumentCount(term_id, static_cast<int>(document_counts.size()));
         }
     }
-    const double inv_word_count = 1.0 / words.size();
-    for (const std::string &word : words)
+    for (std::size_t i = first_index; i < document_terms_.size(); ++i)
     {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
+        std::sort(document_terms_[i].begin(), document_terms_[i].end());
+    }
+    UpdateDocumentCountLog();
+    epoch_ = NextEpoch();
+}
+
+void SearchServer::RemoveDocument(int document_id)
+{
+    const auto it = document_id_to_index_.find(document_id);
+    if (it == document_id_to_index_.end())
+    {
+        return;
+    }
+    const int document_index = it->second;
+    document_id_to_index_.erase(it);
+
+    std::vector<std::pair<TermId, TermCount>> &document_terms =
+        document_terms_[document_index];
+    for (const auto &[term_id, _] : document_terms)
+    {
+        ChangeTermDocumentCount(term_id, -1);
+    }
+    document_terms.clear();
+    word_freqs_cache_.document_word_freqs.erase(document_id);
+    is_removed_document_[document_index] = true;
+    ++removed_document_count_;
+    live_documents_.Remove(document_index);
+    UpdateDocumentCountLog();
+    epoch_ = NextEpoch();
+
+    if (removed_document_count_ >
+        MAX_REMOVED_DOCUMENT_SHARE * static_cast<double>(document_ids_.size()))
+    {
+        CompactDocuments();
     }
-    documents_.emplace(document_id,
-                       DocumentData{ComputeAverageRating(ratings), status});
-    document_ids_.push_back(document_id);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(
-    const std::string &raw_query,
-    const DocumentStatus expected_status) const
+    std::string_view raw_query,
+    const DocumentStatus expected_status,
+    const QueryOptions &options) const
+{
+    return FindTopDocumentsForQuery(ParseQuery(raw_query), expected_status, options, false);
+}
+
+std::vector<Document> SearchServer::FindTopDocumentsForQuery(
+    const Query &query,
+    const DocumentStatus expected_status,
+    const QueryOptions &options,
+    bool is_parallel) const
+{
+    if (!query_cache_)
+    {
+        return FindTopDocumentsByStatus(query, expected_status, options, is_parallel);
+    }
+    const std::vector<TermId> *required_terms = GetRequiredTerms(query, options);
+    if (required_terms == nullptr)
+    {
+        return {};
+    }
+    // IDF по статистике сервера определяются эпохой, а по статистике
+    // коллекции могут меняться вместе с другими серверами
+    const QueryCache::Key key{
+        query.plus_terms, query.minus_terms, *required_terms,
+        query.has_collection_stats ? query.inverse_document_freqs : std::vector<double>{},
+        expected_status, options.limit, options.offset};
+    if (std::optional<std::vector<Document>> documents = query_cache_->Find(key, epoch_))
+    {
+        return *std::move(documents);
+    }
+    std::vector<Document> documents =
+        FindTopDocumentsByStatus(query, expected_status, options, is_parallel);
+    query_cache_->Insert(key, documents, epoch_);
+    return documents;
+}
+
+std::vector<Document> SearchServer::FindTopDocumentsByStatus(
+    const Query &query,
+    const DocumentStatus expected_status,
+    const QueryOptions &options,
+    bool is_parallel) const
 {
-    return FindTopDocuments(
-        raw_query,
+    const auto it = status_document_indexes_.find(expected_status);
+    const std::vector<TermId> *required_terms = GetRequiredTerms(query, options);
+    if (it == status_document_indexes_.end() || required_terms == nullptr)
+    {
+        return {};
+    }
+    // Документов с редким статусом мало среди живых и меньше, чем в самом
+    // коротком списке слова запроса: дешевле проверить каждый такой документ,
+    // чем обойти списки целиком. Перебор однопоточный, поэтому параллельный
+    // поиск всегда идёт по спискам
+    const std::vector<int> &document_indexes = it->second;
+    std::size_t min_posting_count = std::numeric_limits<std::size_t>::max();
+    for (const TermId term_id : query.plus_terms)
+    {
+        min_posting_count = std::min(min_posting_count, term_postings_[term_id].Size());
+    }
+    if (!is_parallel &&
+        document_indexes.size() < MAX_RARE_STATUS_SHARE * GetDocumentCount() &&
+        document_indexes.size() < min_posting_count)
+    {
+        TopDocuments top_documents(GetMaxResultCount(options));
+        FindDocumentsAmong(query, *required_terms, document_indexes, top_documents);
+        return ExtractResultPage(top_documents, options);
+    }
+    return FindTopDocumentsForQuery(
+        query,
         [expected_status](
             const int id,
             const DocumentStatus status,
             const int rating)
         {
             return status == expected_status;
-        });
+        },
+        options, is_parallel);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
+                                                     const QueryOptions &options) const
+{
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL, options);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(
+    std::string_view raw_query,
+    const DocumentStatus expected_status) const
+{
+    return FindTopDocuments(raw_query, expected_status, QueryOptions{});
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::string &raw_query) const
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const
 {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
-int SearchServer::GetDocumentCount() const { return documents_.size(); }
+SearchServer::PreparedQuery SearchServer::PrepareQuery(std::string_view raw_query) const
+{
+    return PreparedQuery(ParseQuery(raw_query), epoch_, raw_query);
+}
+
+SearchServer::PreparedQuery SearchServer::PrepareQuery(
+    std::string_view raw_query, int document_count,
+    const std::map<std::string_view, int> &word_document_counts) const
+{
+    Query query = ParseQuery(raw_query);
+    // Слова запроса есть в документах этого сервера, а значит, и в коллекции
+    const double document_count_log = std::log(static_cast<double>(document_count));
+    for (std::size_t i = 0; i < query.plus_terms.size(); ++i)
+    {
+        const int word_document_count =
+            word_document_counts.at(terms_.GetWord(query.plus_terms[i]));
+        query.inverse_document_freqs[i] =
+            document_count_log - std::log(static_cast<double>(word_document_count));
+    }
+    query.has_collection_stats = true;
+    return PreparedQuery(std::move(query), epoch_, raw_query);
+}
 
-std::tuple<std::vector<std::string>, DocumentStatus> SearchServer::MatchDocument(
-    const std::string &raw_query, int document_id) const
+std::vector<Document> SearchServer::FindTopDocuments(
+    const PreparedQuery &query,
+    const DocumentStatus expected_status,
+    const QueryOptions &options) const
 {
-    const Query query = ParseQuery(raw_query);
-    std::vector<std::string> matched_words;
-    for (const std::string &word : query.plus_words)
+    if (query.epoch_ != epoch_)
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        return FindTopDocumentsForQuery(ParseQuery(query.raw_query_), expected_status,
+                                        options, false);
+    }
+    return FindTopDocumentsForQuery(query.query_, expected_status, options, false);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery &query,
+                                                     const QueryOptions &options) const
+{
+    return FindTopDocuments(query, DocumentStatus::ACTUAL, options);
+}
+
+int SearchServer::GetDocumentCount() const
+{
+    return static_cast<int>(document_ids_.size()) - removed_document_count_;
+}
+
+int SearchServer::GetWordDocumentCount(std::string_view word) const
+{
+    const std::optional<TermId> term_id = terms_.Find(word);
+    return term_id ? term_document_counts_[*term_id] : 0;
+}
+
+const std::map<std::string_view, double> &SearchServer::GetWordFrequencies(
+    int document_id) const
+{
+    static const std::map<std::string_view, double> empty_word_freqs;
+    const auto it = document_id_to_index_.find(document_id);
+    if (it == document_id_to_index_.end())
+    {
+        return empty_word_freqs;
+    }
+    // Словарь собирается при первом запросе и не участвует в поиске
+    const std::lock_guard guard(word_freqs_cache_.mutex);
+    const auto [word_freqs_it, is_new] =
+        word_freqs_cache_.document_word_freqs.try_emplace(document_id);
+    if (is_new)
+    {
+        const double word_count = document_word_counts_[it->second];
+        for (const auto &[term_id, count] : document_terms_[it->second])
         {
-            continue;
+            word_freqs_it->second.emplace(terms_.GetWord(term_id), count / word_count);
         }
-        if (word_to_document_freqs_.at(word).count(document_id))
+    }
+    return word_freqs_it->second;
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(
+    std::string_view raw_query, int document_id) const
+{
+    return MatchDocumentForQuery(ParseQuery(raw_query), document_id, false);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(
+    const PreparedQuery &query, int document_id) const
+{
+    if (query.epoch_ != epoch_)
+    {
+        return MatchDocumentForQuery(ParseQuery(query.raw_query_), document_id, false);
+    }
+    return MatchDocumentForQuery(query.query_, document_id, false);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocumentForQuery(
+    const Query &query, int document_id, bool is_parallel) const
+{
+    const int document_index = document_id_to_index_.at(document_id);
+    const DocumentStatus status = document_statuses_[document_index];
+    const auto contains_term = [this, document_index](const TermId term_id)
+    {
+        return DocumentContainsTerm(document_index, term_id);
+    };
+
+    // Документ без обязательного слова не подходит под запрос
+    if (query.has_missing_required_word ||
+        !std::all_of(query.required_terms.begin(), query.required_terms.end(), contains_term))
+    {
+        return std::tuple{std::vector<std::string_view>{}, status};
+    }
+
+    if (is_parallel)
+    {
+        if (std::any_of(std::execution::par, query.minus_terms.begin(),
+                        query.minus_terms.end(), contains_term))
         {
-            matched_words.push_back(word);
+            return std::tuple{std::vector<std::string_view>{}, status};
         }
+        std::vector<TermId> matched_terms(query.plus_terms.size());
+        matched_terms.erase(std::copy_if(std::execution::par, query.plus_terms.begin(),
+                                         query.plus_terms.end(), matched_terms.begin(),
+                                         contains_term),
+                            matched_terms.end());
+        std::vector<std::string_view> matched_words(matched_terms.size());
+        std::transform(std::execution::par, matched_terms.begin(), matched_terms.end(),
+                       matched_words.begin(),
+                       [this](const TermId term_id)
+                       { return terms_.GetWord(term_id); });
+        std::sort(std::execution::par, matched_words.begin(), matched_words.end());
+        // Слова запроса уже без повторов, unique лишь страхует выдачу
+        matched_words.erase(std::unique(matched_words.begin(), matched_words.end()),
+                            matched_words.end());
+        return std::tuple{matched_words, status};
     }
-    for (const std::string &word : query.minus_words)
+
+    std::vector<std::string_view> matched_words;
+    for (const TermId term_id : query.minus_terms)
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        if (DocumentContainsTerm(document_index, term_id))
         {
-            continue;
+            return std::tuple{matched_words, status};
+        }
+    }
+    for (const TermId term_id : query.plus_terms)
+    {
+        if (DocumentContainsTerm(document_index, term_id))
+        {
+            matched_words.push_back(terms_.GetWord(term_id));
+        }
+    }
+    std::sort(matched_words.begin(), matched_words.end());
+    return std::tuple{matched_words, status};
+}
+
+int SearchServer::GetDocumentId(int index) const
+{
+    if (index < 0 || index >= GetDocumentCount())
+    {
+        throw std::out_of_range("Document index is out of range"s);
+    }
+    return document_ids_[live_documents_.GetDocumentIndex(index)];
+}
+
+void SearchServer::EnableQueryCache(std::size_t max_bytes)
+{
+    query_cache_.emplace(max_bytes);
+}
+
+void SearchServer::DisableQueryCache()
+{
+    query_cache_.reset();
+}
+
+QueryCache::Stats SearchServer::GetQueryCacheStats() const
+{
+    return query_cache_ ? query_cache_->GetStats() : QueryCache::Stats{0, 0, 0, 0};
+}
+
+void SearchServer::SetPostingListEncoding(PostingListEncoding encoding)
+{
+    posting_list_encoding_ = encoding;
+    for (PostingList &postings : term_postings_)
+    {
+        postings.SetEncoding(encoding);
+    }
+}
+
+SearchServer::MemoryStats SearchServer::GetMemoryStats() const
+{
+    MemoryStats stats{};
+    stats.term_dictionary_bytes = terms_.GetMemoryUsage();
+
+    std::size_t non_empty_posting_lists = 0;
+    stats.postings_bytes =
+        GetMemoryUsage(term_postings_) + GetMemoryUsage(term_document_counts_) +
+        GetMemoryUsage(term_document_count_logs_);
+    for (const PostingList &postings : term_postings_)
+    {
+        stats.postings_bytes += postings.GetMemoryUsage();
+        stats.posting_count += postings.Size();
+        if (!postings.Empty())
+        {
+            ++non_empty_posting_lists;
         }
-        if (word_to_document_freqs_.at(word).count(document_id))
+    }
+
+    stats.document_metadata_bytes =
+        GetMemoryUsage(document_word_counts_) + GetMemoryUsage(document_ratings_) +
+        GetMemoryUsage(document_statuses_) + GetMemoryUsage(is_removed_document_) +
+        live_documents_.GetMemoryUsage() + GetMemoryUsage(document_terms_) +
+        GetMemoryUsage(status_document_indexes_);
+    for (const auto &document_terms : document_terms_)
+    {
+        stats.document_metadata_bytes += GetMemoryUsage(document_terms);
+    }
+    {
+        const std::lock_guard guard(word_freqs_cache_.mutex);
+        stats.document_metadata_bytes +=
+            GetMemoryUsage(word_freqs_cache_.document_word_freqs);
+        for (const auto &[_, word_freqs] : word_freqs_cache_.document_word_freqs)
         {
-            matched_words.clear();
-            break;
+            stats.document_metadata_bytes += GetMemoryUsage(word_freqs);
         }
     }
-    return std::tuple{matched_words, documents_.at(document_id).status};
+    for (const auto &[_, document_indexes] : status_document_indexes_)
+    {
+        stats.document_metadata_bytes += GetMemoryUsage(document_indexes);
+    }
+
+    stats.document_ids_bytes =
+        GetMemoryUsage(document_ids_) + GetMemoryUsage(document_id_to_index_);
+    // Сами стоп-слова хранятся в словаре терминов
+    stats.stop_words_bytes = GetMemoryUsage(is_stop_term_);
+
+    stats.term_count = terms_.Size();
+    stats.average_posting_length =
+        non_empty_posting_lists == 0
+            ? 0.0
+            : stats.posting_count / static_cast<double>(non_empty_posting_lists);
+    return stats;
 }
 
-int SearchServer::GetDocumentId(int index) const { return document_ids_.at(index); }
+bool SearchServer::DocumentContainsTerm(int document_index, TermId term_id) const
+{
+    const std::vector<std::pair<TermId, TermCount>> &document_terms =
+        document_terms_[document_index];
+    const auto it = std::lower_bound(
+        document_terms.begin(), document_terms.end(), term_id,
+        [](const std::pair<TermId, TermCount> &term, TermId id) { return term.first < id; });
+    return it != document_terms.end() && it->first == term_id;
+}
 
-bool SearchServer::IsStopWord(const std::string &word) const
+bool SearchServer::IsStopWord(std::string_view word) const
 {
-    return stop_words_.count(word) > 0;
+    const std::optional<TermId> term_id = terms_.Find(word);
+    return term_id && is_stop_term_[*term_id];
 }
 
-std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string &text) const
+std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text) const
 {
-    std::vector<std::string> words;
-    for (const std::string &word : SplitIntoWords(text))
+    std::vector<std::string_view> words;
+    for (const std::string_view word : SplitIntoWords(text))
     {
         if (!IsStopWord(word))
         {
@@ -138,9 +576,100 @@ std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string &t
     return words;
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string text) const
+void SearchServer::CheckNewDocumentId(int document_id) const
+{
+    if (document_id < 0)
+    {
+        throw std::invalid_argument("Document ID is negative"s);
+    }
+    if (document_id_to_index_.count(document_id))
+    {
+        throw std::invalid_argument(
+            "Search Server already contains document with ID '"s +
+            std::to_string(document_id) + "'"s);
+    }
+}
+
+SearchServer::DocumentWords SearchServer::ParseDocument(std::string_view text) const
+{
+    DocumentWords words{{}, 0};
+    for (const std::string_view word : SplitIntoWordsNoStop(text))
+    {
+        if (!IsValidWord(word))
+        {
+            throw std::invalid_argument("Word '"s + std::string(word) +
+                                        "' in document is not valid"s);
+        }
+        ++words.word_counts[word];
+        ++words.word_count;
+    }
+    return words;
+}
+
+TermId SearchServer::AddTerm(std::string_view word)
+{
+    const TermId term_id = terms_.Add(word);
+    if (term_id == term_postings_.size())
+    {
+        term_postings_.emplace_back(posting_list_encoding_);
+        is_stop_term_.push_back(false);
+        term_document_counts_.push_back(0);
+        term_document_count_logs_.push_back(0.0);
+    }
+    return term_id;
+}
+
+void SearchServer::CompactDocuments()
+{
+    std::vector<int> new_indexes(document_ids_.size(), -1);
+    int live_count = 0;
+    for (std::size_t i = 0; i < document_ids_.size(); ++i)
+    {
+        if (is_removed_document_[i])
+        {
+            continue;
+        }
+        if (static_cast<std::size_t>(live_count) != i)
+        {
+            document_ids_[live_count] = document_ids_[i];
+            document_word_counts_[live_count] = document_word_counts_[i];
+            document_ratings_[live_count] = document_ratings_[i];
+            document_statuses_[live_count] = document_statuses_[i];
+            document_terms_[live_count] = std::move(document_terms_[i]);
+        }
+        new_indexes[i] = live_count++;
+    }
+    document_ids_.resize(live_count);
+    document_word_counts_.resize(live_count);
+    document_ratings_.resize(live_count);
+    document_statuses_.resize(live_count);
+    document_terms_.resize(live_count);
+    is_removed_document_.assign(live_count, false);
+    removed_document_count_ = 0;
+    live_documents_.Reset(live_count);
+    for (auto &[_, document_indexes] : status_document_indexes_)
+    {
+        document_indexes.clear();
+    }
+    for (int i = 0; i < live_count; ++i)
+    {
+        status_document_indexes_[document_statuses_[i]].push_back(i);
+    }
+
+    for (PostingList &postings : term_postings_)
+    {
+        postings.RenumberDocuments(new_indexes, document_word_counts_);
+    }
+    for (auto &[_, document_index] : document_id_to_index_)
+    {
+        document_index = new_indexes[document_index];
+    }
+}
+
+SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const
 {
     bool is_minus = false;
+    bool is_required = false;
     if (text.empty())
     {
         throw std::invalid_argument("Query word is empty"s);
@@ -148,39 +677,210 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string text) const
     if (text[0] == '-')
     {
         is_minus = true;
-        text = text.substr(1);
+        text.remove_prefix(1);
+    }
+    else if (text[0] == '+')
+    {
+        is_required = true;
+        text.remove_prefix(1);
     }
     if (!IsValidWord(text))
     {
-        throw std::invalid_argument("'"s + text + "' is not valid query word"s);
+        throw std::invalid_argument("'"s + std::string(text) +
+                                    "' is not valid query word"s);
     }
-    return QueryWord{text, is_minus, IsStopWord(text)};
+    const std::optional<TermId> term_id = terms_.Find(text);
+    return QueryWord{term_id, is_minus, is_required, term_id && is_stop_term_[*term_id]};
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string &text) const
+SearchServer::Query SearchServer::ParseQuery(std::string_view text) const
 {
     Query query;
-    for (const std::string &word : SplitIntoWords(text))
+    for (const std::string_view word : SplitIntoWords(text))
     {
         const QueryWord query_word = ParseQueryWord(word);
-        if (!query_word.is_stop)
+        if (query_word.is_stop)
+        {
+            continue;
+        }
+        // Слова, которых нет в словаре или в неудалённых документах,
+        // не влияют на выдачу, пока не обязательны
+        if (!query_word.term_id || term_document_counts_[*query_word.term_id] == 0)
         {
-            if (query_word.is_minus)
+            if (!query_word.is_minus)
             {
-                query.minus_words.insert(query_word.data);
+                query.has_missing_plus_word = true;
+                query.has_missing_required_word |= query_word.is_required;
             }
-            else
+            continue;
+        }
+        if (query_word.is_minus)
+        {
+            query.minus_terms.push_back(*query_word.term_id);
+        }
+        else
+        {
+            query.plus_terms.push_back(*query_word.term_id);
+            if (query_word.is_required)
             {
-                query.plus_words.insert(query_word.data);
+                query.required_terms.push_back(*query_word.term_id);
             }
         }
     }
+    for (std::vector<TermId> *terms :
+         {&query.plus_terms, &query.minus_terms, &query.required_terms})
+    {
+        std::sort(terms->begin(), terms->end());
+        terms->erase(std::unique(terms->begin(), terms->end()), terms->end());
+    }
+    for (const TermId term_id : query.plus_terms)
+    {
+        query.inverse_document_freqs.push_back(ComputeWordInverseDocumentFreq(term_id));
+    }
     return query;
 }
 
+ScoreAccumulator &SearchServer::GetThreadScoreAccumulator()
+{
+    thread_local ScoreAccumulator accumulator;
+    return accumulator;
+}
+
+int SearchServer::GetParallelRangeCount()
+{
+    // Отрезков больше, чем потоков, чтобы неравномерные отрезки
+    // не оставляли потоки без работы
+    return 4 * static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+std::uint64_t SearchServer::NextEpoch()
+{
+    static std::atomic<std::uint64_t> last_epoch = 0;
+    return ++last_epoch;
+}
+
+std::vector<Document> SearchServer::ExtractResultPage(TopDocuments &top_documents,
+                                                      const QueryOptions &options)
+{
+    std::vector<Document> documents = top_documents.Extract();
+    documents.erase(documents.begin(),
+                    documents.begin() + std::min(options.offset, documents.size()));
+    return documents;
+}
+
+const std::vector<TermId> *SearchServer::GetRequiredTerms(const Query &query,
+                                                         const QueryOptions &options)
+{
+    if (options.match == MatchMode::ALL_WORDS)
+    {
+        return query.has_missing_plus_word ? nullptr : &query.plus_terms;
+    }
+    return query.has_missing_required_word ? nullptr : &query.required_terms;
+}
+
+void SearchServer::FindDocumentsAmong(const Query &query,
+                                      const std::vector<TermId> &required_terms,
+                                      const std::vector<int> &document_indexes,
+                                      TopDocuments &top_documents) const
+{
+    std::vector<PostingList::Cursor> minus_cursors;
+    for (const TermId term_id : query.minus_terms)
+    {
+        minus_cursors.emplace_back(term_postings_[term_id]);
+    }
+    std::vector<PostingList::Cursor> plus_cursors;
+    for (const TermId term_id : query.plus_terms)
+    {
+        plus_cursors.emplace_back(term_postings_[term_id]);
+    }
+
+    const auto skip_to = [](PostingList::Cursor &cursor, const int document_index)
+    {
+        cursor.SkipTo(document_index);
+        return !cursor.IsEnd() && cursor.GetDocumentIndex() == document_index;
+    };
+    for (const int document_index : document_indexes)
+    {
+        if (is_removed_document_[document_index] ||
+            std::any_of(minus_cursors.begin(), minus_cursors.end(),
+                        [&](PostingList::Cursor &cursor)
+                        { return skip_to(cursor, document_index); }))
+        {
+            continue;
+        }
+        std::size_t matched_count = 0;
+        std::size_t matched_required_count = 0;
+        double relevance = 0.0;
+        for (std::size_t i = 0; i < plus_cursors.size(); ++i)
+        {
+            if (skip_to(plus_cursors[i], document_index))
+            {
+                const double term_freq = plus_cursors[i].GetCount() /
+                    static_cast<double>(document_word_counts_[document_index]);
+                relevance += term_freq * query.inverse_document_freqs[i];
+                ++matched_count;
+                matched_required_count += std::binary_search(
+                    required_terms.begin(), required_terms.end(), query.plus_terms[i]);
+            }
+        }
+        if (matched_count > 0 && matched_required_count == required_terms.size())
+        {
+            top_documents.Add({document_ids_[document_index], relevance,
+                               document_ratings_[document_index]});
+        }
+    }
+}
+
+void SearchServer::ExcludeMinusWordDocuments(const Query &query, int first_document_index,
+                                             int last_document_index,
+                                             ScoreAccumulator &accumulator) const
+{
+    for (const TermId term_id : query.minus_terms)
+    {
+        term_postings_[term_id].ForEachPostingInRange(
+            first_document_index, last_document_index,
+            [&accumulator](const int document_index, TermCount)
+            { accumulator.Exclude(document_index); });
+    }
+}
+
 // Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string &word) const
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term_id) const
 {
-    return std::log(GetDocumentCount() * 1.0 /
-                    word_to_document_freqs_.at(word).size());
-}
\ No newline at end of file
+    return document_count_log_ - term_document_count_logs_[term_id];
+}
+
+void SearchServer::ChangeTermDocumentCount(TermId term_id, int delta)
+{
+    const int document_count = term_document_counts_[term_id] += delta;
+    term_document_count_logs_[term_id] =
+        document_count > 0 ? std::log(static_cast<double>(document_count)) : 0.0;
+}
+
+void SearchServer::UpdateDocumentCountLog()
+{
+    const int document_count = GetDocumentCount();
+    document_count_log_ =
+        document_count > 0 ? std::log(static_cast<double>(document_count)) : 0.0;
+}
+
+// SearchServer::WordFrequenciesCache
+
+SearchServer::WordFrequenciesCache::WordFrequenciesCache(const WordFrequenciesCache &) {}
+
+SearchServer::WordFrequenciesCache &SearchServer::WordFrequenciesCache::operator=(
+    const WordFrequenciesCache &other)
+{
+    if (this != &other)
+    {
+        const std::lock_guard guard(mutex);
+        document_word_freqs.clear();
+    }
+    return *this;
+}
+
+// SearchServer::PreparedQuery
+
+SearchServer::PreparedQuery::PreparedQuery(Query query, std::uint64_t epoch,
+                                           std::string_view raw_query)
+    : query_(std::move(query)), epoch_(epoch), raw_query_(raw_query) {}
@@ -5,9 +5,72 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <numeric>
+#include <execution>
+#include <type_traits>
+
+#include <optional>
+#include <mutex>
+#include <string>
+#include <string_view>
 
 #include "string_processing.h"
 #include "document.h"
+#include "posting_list.h"
+#include "term_dictionary.h"
+#include "top_documents.h"
+#include "score_accumulator.h"
+#include "query_cache.h"
+#include "live_document_index.h"
+
+const int MAX_RESULT_DOCUMENT_COUNT = 5;
+const double MAX_REMOVED_DOCUMENT_SHARE = 0.25;
+// Доля документов статуса, до которой их дешевле проверить по одному
+const double MAX_RARE_STATUS_SHARE = 0.1;
+
+/**
+ * Способ обхода списков вхождений при поиске.
+ * EXHAUSTIVE считает релевантность всех документов запроса.
+ * PRUNED (MaxScore) обходит документы по возрастанию номеров и пропускает те,
+ * что по верхним оценкам вклада слов уже не попадут в выдачу.
+ * Результаты обоих способов совпадают
+ */
+enum class RetrievalMode
+{
+    EXHAUSTIVE,
+    PRUNED,
+};
+
+/**
+ * Какие документы подходят под запрос.
+ * ANY_WORD - документы хотя бы с одним плюс-словом и со всеми словами,
+ * отмеченными в запросе как обязательные: +слово.
+ * ALL_WORDS - документы со всеми плюс-словами
+ */
+enum class MatchMode
+{
+    ANY_WORD,
+    ALL_WORDS,
+};
+
+// Какую часть выдачи вернуть: limit документов, начиная с offset-го
+struct QueryOptions
+{
+    std::size_t limit = MAX_RESULT_DOCUMENT_COUNT;
+    std::size_t offset = 0;
+    RetrievalMode mode = RetrievalMode::EXHAUSTIVE;
+    MatchMode match = MatchMode::ANY_WORD;
+};
+
+// Сколько лучших документов нужно отобрать, чтобы получить страницу options
+std::size_t GetMaxResultCount(const QueryOptions &options);
+
+// Оставляет перегрузку только для политик выполнения из <execution>
+template <typename ExecutionPolicy>
+using EnableIfExecutionPolicy =
+    std::enable_if_t<std::is_execution_policy_v<std::decay_t<ExecutionPolicy>>, bool>;
 
 class SearchServer
 {
@@ -17,84 +80,435 @@ public:
 
     explicit SearchServer(const std::string &stop_words_text);
 
+    explicit SearchServer(std::string_view stop_words_text);
+
     explicit SearchServer();
 
-    void AddDocument(int document_id, const std::string &document,
+    void AddDocument(int document_id, std::string_view document,
                      DocumentStatus status, const std::vector<int> &ratings);
 
+    struct NewDocument
+    {
+        int id;
+        std::string_view text;
+        DocumentStatus status;
+        std::vector<int> ratings;
+    };
+
+    /**
+     * Добавляет пакет документов. Тексты разбираются и проверяются
+     * параллельно, каждый поток строит частичный индекс, после чего
+     * частичные индексы сливаются в общий за один проход.
+     * Если хотя бы один документ некорректен, не добавляется ни один
+     */
+    void AddDocuments(const std::vector<NewDocument> &documents);
+
+    /**
+     * Помечает документ удалённым: запросы сразу перестают его видеть.
+     * Вхождения и метаданные удалённых документов вычищаются одним проходом,
+     * когда их доля превышает MAX_REMOVED_DOCUMENT_SHARE
+     */
+    void RemoveDocument(int document_id);
+
     template <typename Predicate>
-    std::vector<Document> FindTopDocuments(const std::string &raw_query,
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                           const Predicate predicate,
+                                           const QueryOptions &options) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                           const DocumentStatus expected_status,
+                                           const QueryOptions &options) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                           const QueryOptions &options) const;
+
+    template <typename Predicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
                                            const Predicate predicate) const;
 
-    std::vector<Document> FindTopDocuments(const std::string &raw_query,
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
                                            const DocumentStatus expected_status) const;
 
-    std::vector<Document> FindTopDocuments(const std::string &raw_query) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    /**
+     * Те же варианты поиска с политикой выполнения. При параллельной политике
+     * документы обрабатываются отрезками в разных потоках, выдача совпадает
+     * с последовательным поиском. Предикат должен допускать вызов из разных
+     * потоков
+     */
+    template <typename ExecutionPolicy, typename Predicate,
+              EnableIfExecutionPolicy<ExecutionPolicy> = true>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
+                                           std::string_view raw_query,
+                                           const Predicate predicate,
+                                           const QueryOptions &options) const;
+
+    template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = true>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
+                                           std::string_view raw_query,
+                                           const DocumentStatus expected_status,
+                                           const QueryOptions &options) const;
+
+    template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = true>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
+                                           std::string_view raw_query,
+                                           const QueryOptions &options) const;
+
+    template <typename ExecutionPolicy, typename Predicate,
+              EnableIfExecutionPolicy<ExecutionPolicy> = true>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
+                                           std::string_view raw_query,
+                                           const Predicate predicate) const;
+
+    template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = true>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
+                                           std::string_view raw_query,
+                                           const DocumentStatus expected_status) const;
+
+    template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = true>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
+                                           std::string_view raw_query) const;
+
+    class PreparedQuery;
+
+    /**
+     * Разбирает и проверяет запрос один раз: слова переводятся в ID,
+     * для плюс-слов считается IDF. Подготовленный запрос выполняется
+     * многократно без разбора, но только этим сервером. Если индекс
+     * с момента подготовки изменился, запрос разбирается заново
+     */
+    PreparedQuery PrepareQuery(std::string_view raw_query) const;
+
+    /**
+     * Подготавливает запрос с IDF по статистике всей коллекции, частью
+     * которой является этот сервер: в коллекции document_count документов,
+     * из них word_document_counts[word] содержат слово. Такой запрос
+     * не кэшируется и при изменении индекса разбирается заново уже
+     * с собственной статистикой сервера
+     */
+    PreparedQuery PrepareQuery(std::string_view raw_query, int document_count,
+                               const std::map<std::string_view, int> &word_document_counts) const;
+
+    template <typename Predicate>
+    std::vector<Document> FindTopDocuments(const PreparedQuery &query,
+                                           const Predicate predicate,
+                                           const QueryOptions &options) const;
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery &query,
+                                           const DocumentStatus expected_status,
+                                           const QueryOptions &options) const;
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery &query,
+                                           const QueryOptions &options = {}) const;
 
     int GetDocumentCount() const;
 
-    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(
-        const std::string &raw_query, int document_id) const;
+    // Число неудалённых документов, содержащих слово
+    int GetWordDocumentCount(std::string_view word) const;
+
+    /**
+     * Частоты слов документа. Для неизвестного ID возвращает пустой словарь
+     */
+    const std::map<std::string_view, double> &GetWordFrequencies(int document_id) const;
+
+    /**
+     * Возвращаемые слова ссылаются на словарь сервера и действительны,
+     * пока жив сервер
+     */
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+        std::string_view raw_query, int document_id) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+        const PreparedQuery &query, int document_id) const;
+
+    /**
+     * Сначала проверяет минус-слова и выходит при первом найденном,
+     * затем параллельно проверяет плюс-слова. Слова выдачи отсортированы
+     * и не повторяются
+     */
+    template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = true>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+        ExecutionPolicy &&policy, std::string_view raw_query, int document_id) const;
+
+    template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = true>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+        ExecutionPolicy &&policy, const PreparedQuery &query, int document_id) const;
 
     int GetDocumentId(int index) const;
 
-private:
-    struct DocumentData
+    /**
+     * Перекодирует все списки вхождений. Сжатые списки занимают в несколько
+     * раз меньше памяти ценой поблочного декодирования при поиске
+     */
+    void SetPostingListEncoding(PostingListEncoding encoding);
+
+    struct MemoryStats
     {
-        int rating;
-        DocumentStatus status;
+        std::size_t term_dictionary_bytes;
+        std::size_t postings_bytes;
+        std::size_t document_metadata_bytes;
+        std::size_t document_ids_bytes;
+        std::size_t stop_words_bytes;
+        std::size_t term_count;
+        std::size_t posting_count;
+        double average_posting_length;
     };
 
-    const std::set<std::string> stop_words_;
-    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
+    /**
+     * Приблизительный объём памяти индекса по частям. Проходит по спискам
+     * вхождений и документам, ничего не выделяя, поэтому подходит для
+     * регулярного сбора метрик
+     */
+    MemoryStats GetMemoryStats() const;
+
+    /**
+     * Включает кэш результатов поиска по статусу объёмом до max_bytes.
+     * Ключ кэша - разобранный запрос, поэтому запросы, отличающиеся только
+     * порядком и повторами слов, делят одну запись. Любое изменение индекса
+     * сбрасывает кэш. Поиск с предикатом не кэшируется
+     */
+    void EnableQueryCache(std::size_t max_bytes);
+
+    void DisableQueryCache();
+
+    // Счётчики кэша результатов. Нули, если кэш выключен
+    QueryCache::Stats GetQueryCacheStats() const;
+
+private:
+    TermDictionary terms_;
+    std::vector<bool> is_stop_term_;
+    PostingListEncoding posting_list_encoding_ = PostingListEncoding::PLAIN;
+    std::vector<PostingList> term_postings_;
+
+    // Документам выдаются плотные внутренние номера в порядке добавления,
+    // по ним адресуются вхождения и метаданные документов
+    std::map<int, int> document_id_to_index_;
     std::vector<int> document_ids_;
+    // Число слов документа без стоп-слов: TF = число вхождений / длина
+    std::vector<int> document_word_counts_;
+    std::vector<int> document_ratings_;
+    std::vector<DocumentStatus> document_statuses_;
+    // Номера документов каждого статуса по возрастанию, включая удалённые
+    // до уплотнения
+    std::map<DocumentStatus, std::vector<int>> status_document_indexes_;
+    // Прямой индекс: ID слов документа по возрастанию и число их вхождений
+    std::vector<std::vector<std::pair<TermId, TermCount>>> document_terms_;
+
+    // Удалённые документы остаются в индексе до уплотнения
+    std::vector<bool> is_removed_document_;
+    int removed_document_count_ = 0;
+    // Порядковый номер среди неудалённых -> внутренний номер, для GetDocumentId
+    LiveDocumentIndex live_documents_;
+    // Число неудалённых документов, содержащих слово
+    std::vector<int> term_document_counts_;
+    // IDF = log(число документов) - log(число документов со словом).
+    // Логарифмы обновляются только для слов изменившихся документов,
+    // поэтому запрос не вызывает std::log и ничего не пересчитывает
+    std::vector<double> term_document_count_logs_;
+    double document_count_log_ = 0.0;
+
+    // Меняется при каждом изменении индекса. Значения уникальны среди всех
+    // серверов, поэтому по эпохе запрос отличает и чужой сервер
+    std::uint64_t epoch_ = NextEpoch();
+    mutable std::optional<QueryCache> query_cache_;
+
+    // Словари частот, выданные GetWordFrequencies. Ключи ссылаются на terms_,
+    // поэтому копия сервера начинает с пустого кэша
+    struct WordFrequenciesCache
+    {
+        WordFrequenciesCache() = default;
+        WordFrequenciesCache(const WordFrequenciesCache &);
+        WordFrequenciesCache &operator=(const WordFrequenciesCache &);
+
+        std::map<int, std::map<std::string_view, double>> document_word_freqs;
+        std::mutex mutex;
+    };
+    mutable WordFrequenciesCache word_freqs_cache_;
+
+    bool DocumentContainsTerm(int document_index, TermId term_id) const;
 
-    bool IsStopWord(const std::string &word) const;
+    bool IsStopWord(std::string_view word) const;
 
-    std::vector<std::string> SplitIntoWordsNoStop(const std::string &text) const;
+    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+
+    void CheckNewDocumentId(int document_id) const;
+
+    struct DocumentWords
+    {
+        std::map<std::string_view, TermCount> word_counts;
+        int word_count;
+    };
+
+    DocumentWords ParseDocument(std::string_view text) const;
+
+    TermId AddTerm(std::string_view word);
+
+    void CompactDocuments();
 
     struct QueryWord
     {
-        std::string data;
+        std::optional<TermId> term_id;
         bool is_minus;
+        bool is_required;
         bool is_stop;
     };
 
-    QueryWord ParseQueryWord(std::string text) const;
+    QueryWord ParseQueryWord(std::string_view text) const;
 
+    // Отсортированные ID слов запроса без повторов и IDF плюс-слов
     struct Query
     {
-        std::set<std::string> plus_words;
-        std::set<std::string> minus_words;
+        std::vector<TermId> plus_terms;
+        std::vector<TermId> minus_terms;
+        // Плюс-слова, отмеченные как обязательные
+        std::vector<TermId> required_terms;
+        std::vector<double> inverse_document_freqs;
+        // Было плюс-слово (обязательное), которого нет в документах
+        bool has_missing_plus_word = false;
+        bool has_missing_required_word = false;
+        // IDF посчитаны по статистике коллекции, а не сервера
+        bool has_collection_stats = false;
     };
 
-    Query ParseQuery(const std::string &text) const;
+    Query ParseQuery(std::string_view text) const;
 
     // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string &word) const;
+    double ComputeWordInverseDocumentFreq(TermId term_id) const;
+
+    void ChangeTermDocumentCount(TermId term_id, int delta);
+
+    void UpdateDocumentCountLog();
+
+    /**
+     * Аккумулятор релевантностей текущего потока. Переиспользуется всеми
+     * запросами потока, поэтому его массивы выделяются один раз
+     */
+    static ScoreAccumulator &GetThreadScoreAccumulator();
+
+    // На сколько отрезков делятся документы при параллельном поиске
+    static int GetParallelRangeCount();
+
+    static std::uint64_t NextEpoch();
+
+    template <typename ExecutionPolicy>
+    static constexpr bool IsParallelPolicy();
+
+    static std::vector<Document> ExtractResultPage(TopDocuments &top_documents,
+                                                   const QueryOptions &options);
+
+    // Ищет по кэшу, если он включён
+    std::vector<Document> FindTopDocumentsForQuery(const Query &query,
+                                                   DocumentStatus expected_status,
+                                                   const QueryOptions &options,
+                                                   bool is_parallel) const;
 
+    std::vector<Document> FindTopDocumentsByStatus(const Query &query,
+                                                   DocumentStatus expected_status,
+                                                   const QueryOptions &options,
+                                                   bool is_parallel) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocumentForQuery(
+        const Query &query, int document_id, bool is_parallel) const;
+
+    /**
+     * При is_parallel документы делятся на отрезки номеров, которые
+     * обрабатываются параллельно, каждый в свой TopDocuments, после чего
+     * лучшие документы отрезков сливаются. Предикат вызывается из разных
+     * потоков
+     */
     template <typename Predicate>
-    std::vector<Document> FindAllDocuments(const Query &query,
-                                           const Predicate predicate) const;
+    std::vector<Document> FindTopDocumentsForQuery(const Query &query,
+                                                   const Predicate predicate,
+                                                   const QueryOptions &options,
+                                                   bool is_parallel) const;
+
+    /**
+     * Передаёт в top_documents подходящие под запрос документы из
+     * document_indexes (по возрастанию), переходя к ним в списках вхождений
+     * пропусками
+     */
+    void FindDocumentsAmong(const Query &query, const std::vector<TermId> &required_terms,
+                            const std::vector<int> &document_indexes,
+                            TopDocuments &top_documents) const;
+
+    /**
+     * Слова, которые должны быть в документе при поиске с options,
+     * или nullptr, если под запрос не подходит ни один документ
+     */
+    static const std::vector<TermId> *GetRequiredTerms(const Query &query,
+                                                       const QueryOptions &options);
+
+    /**
+     * Передаёт в top_documents документы отрезка, содержащие все слова
+     * required_terms. Списки обязательных слов пересекаются от самого
+     * короткого: следующий документ-кандидат ищется в остальных списках
+     * пропусками, так что длинные списки почти не читаются
+     */
+    template <typename Predicate>
+    void FindDocumentsContainingAll(const Query &query,
+                                    const std::vector<TermId> &required_terms,
+                                    const Predicate predicate,
+                                    int first_document_index, int last_document_index,
+                                    TopDocuments &top_documents) const;
+
+    // Помечает в accumulator документы отрезка с минус-словами запроса
+    void ExcludeMinusWordDocuments(const Query &query, int first_document_index,
+                                   int last_document_index,
+                                   ScoreAccumulator &accumulator) const;
 
-    static bool IsValidWord(const std::string &word);
+    /**
+     * Передаёт в top_documents все документы с номерами из
+     * [first_document_index, last_document_index), подходящие под запрос
+     */
+    template <typename Predicate>
+    void FindAllDocuments(const Query &query, const Predicate predicate,
+                          int first_document_index, int last_document_index,
+                          TopDocuments &top_documents) const;
+
+    /**
+     * Передаёт в top_documents только документы, которые могут в него попасть.
+     * Слова упорядочиваются по верхней оценке вклада (максимальный TF * IDF);
+     * документы, встречающиеся лишь в словах с суммарной оценкой ниже
+     * худшего документа выдачи, не рассматриваются, а у остальных подсчёт
+     * прекращается, как только оценка опускается ниже этого порога.
+     * Те же оценки по блокам списков позволяют пропускать целые блоки,
+     * не декодируя их
+     */
+    template <typename Predicate>
+    void FindBestDocuments(const Query &query, const Predicate predicate,
+                           int first_document_index, int last_document_index,
+                           TopDocuments &top_documents) const;
+
+    static bool IsValidWord(std::string_view word);
 };
 
-// templates IMPL
+// Разобранный запрос, см. SearchServer::PrepareQuery
+class SearchServer::PreparedQuery
+{
+private:
+    friend class SearchServer;
 
-const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double EPSILON = 1e-6;
+    Query query_;
+    // Эпоха индекса, в которой запрос разобран. Запрос с другой эпохой
+    // (изменённый или чужой сервер) разбирается заново
+    std::uint64_t epoch_;
+    std::string raw_query_;
+
+    PreparedQuery(Query query, std::uint64_t epoch, std::string_view raw_query);
+};
+
+// templates IMPL
 
 template <typename StringContainer>
-std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer &strings)
+std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer &strings)
 {
-    std::set<std::string> non_empty_strings;
-    for (const std::string &str : strings)
+    std::set<std::string, std::less<>> non_empty_strings;
+    for (const auto &str : strings)
     {
-        if (!str.empty())
+        if (!std::string_view(str).empty())
         {
-            non_empty_strings.insert(str);
+            non_empty_strings.emplace(str);
         }
     }
     return non_empty_strings;
@@ -102,85 +516,482 @@ std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer &strings)
 
 template <typename StringContainer>
 SearchServer::SearchServer(const StringContainer &stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
 {
-    for (const std::string &word : stop_words_)
+    for (const std::string &word : MakeUniqueNonEmptyStrings(stop_words))
     {
         if (!IsValidWord(word))
         {
             throw std::invalid_argument(word + " is not valid stop-word");
         }
+        is_stop_term_[AddTerm(word)] = true;
+    }
+}
+
+template <typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
+                                                     const Predicate predicate,
+                                                     const QueryOptions &options) const
+{
+    return FindTopDocumentsForQuery(ParseQuery(raw_query), predicate, options, false);
+}
+
+template <typename Predicate>
+std::vector<Document> SearchServer::FindTopDocumentsForQuery(const Query &query,
+                                                             const Predicate predicate,
+                                                             const QueryOptions &options,
+                                                             bool is_parallel) const
+{
+    const std::vector<TermId> *required_terms = GetRequiredTerms(query, options);
+    if (required_terms == nullptr)
+    {
+        return {};
+    }
+    const std::size_t max_count = GetMaxResultCount(options);
+    if (max_count == 0)
+    {
+        // Пустая страница: порог отсечения по худшему документу не определён
+        return {};
+    }
+    const auto find_documents = [&](int first_document_index, int last_document_index,
+                                    TopDocuments &top_documents)
+    {
+        if (!required_terms->empty())
+        {
+            FindDocumentsContainingAll(query, *required_terms, predicate,
+                                       first_document_index, last_document_index,
+                                       top_documents);
+        }
+        else if (options.mode == RetrievalMode::PRUNED)
+        {
+            FindBestDocuments(query, predicate, first_document_index, last_document_index,
+                              top_documents);
+        }
+        else
+        {
+            FindAllDocuments(query, predicate, first_document_index, last_document_index,
+                             top_documents);
+        }
+    };
+
+    const int document_count = static_cast<int>(document_ids_.size());
+    TopDocuments top_documents(max_count);
+    if (!is_parallel)
+    {
+        find_documents(0, document_count, top_documents);
+        return ExtractResultPage(top_documents, options);
+    }
+
+    const int range_count = std::max(1, std::min(GetParallelRangeCount(), document_count));
+    std::vector<TopDocuments> range_top_documents(range_count, TopDocuments(max_count));
+    std::vector<int> ranges(range_count);
+    std::iota(ranges.begin(), ranges.end(), 0);
+    std::for_each(std::execution::par, ranges.begin(), ranges.end(),
+                  [&](const int range)
+                  {
+                      // Границы считаются в long long, чтобы произведение не переполнилось
+                      const long long count = document_count;
+                      find_documents(static_cast<int>(count * range / range_count),
+                                     static_cast<int>(count * (range + 1) / range_count),
+                                     range_top_documents[range]);
+                  });
+    for (TopDocuments &range_documents : range_top_documents)
+    {
+        for (const Document &document : range_documents.Extract())
+        {
+            top_documents.Add(document);
+        }
     }
+    return ExtractResultPage(top_documents, options);
 }
 
 template <typename Predicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::string &raw_query,
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
                                                      const Predicate predicate) const
 {
-    const Query query = ParseQuery(raw_query);
-    std::vector<Document> matched_documents = FindAllDocuments(query, predicate);
-    std::sort(
-        matched_documents.begin(),
-        matched_documents.end(),
-        [](const Document &lhs, const Document &rhs)
+    return FindTopDocuments(raw_query, predicate, QueryOptions{});
+}
+
+template <typename ExecutionPolicy>
+constexpr bool SearchServer::IsParallelPolicy()
+{
+    return !std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>;
+}
+
+template <typename ExecutionPolicy, typename Predicate, EnableIfExecutionPolicy<ExecutionPolicy>>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&,
+                                                     std::string_view raw_query,
+                                                     const Predicate predicate,
+                                                     const QueryOptions &options) const
+{
+    return FindTopDocumentsForQuery(ParseQuery(raw_query), predicate, options,
+                                    IsParallelPolicy<ExecutionPolicy>());
+}
+
+template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&,
+                                                     std::string_view raw_query,
+                                                     const DocumentStatus expected_status,
+                                                     const QueryOptions &options) const
+{
+    return FindTopDocumentsForQuery(ParseQuery(raw_query), expected_status, options,
+                                    IsParallelPolicy<ExecutionPolicy>());
+}
+
+template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&policy,
+                                                     std::string_view raw_query,
+                                                     const QueryOptions &options) const
+{
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL, options);
+}
+
+template <typename ExecutionPolicy, typename Predicate, EnableIfExecutionPolicy<ExecutionPolicy>>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&policy,
+                                                     std::string_view raw_query,
+                                                     const Predicate predicate) const
+{
+    return FindTopDocuments(policy, raw_query, predicate, QueryOptions{});
+}
+
+template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&policy,
+                                                     std::string_view raw_query,
+                                                     const DocumentStatus expected_status) const
+{
+    return FindTopDocuments(policy, raw_query, expected_status, QueryOptions{});
+}
+
+template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&policy,
+                                                     std::string_view raw_query) const
+{
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(
+    ExecutionPolicy &&, std::string_view raw_query, int document_id) const
+{
+    return MatchDocumentForQuery(ParseQuery(raw_query), document_id,
+                                 IsParallelPolicy<ExecutionPolicy>());
+}
+
+template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(
+    ExecutionPolicy &&, const PreparedQuery &query, int document_id) const
+{
+    if (query.epoch_ != epoch_)
+    {
+        return MatchDocumentForQuery(ParseQuery(query.raw_query_), document_id,
+                                     IsParallelPolicy<ExecutionPolicy>());
+    }
+    return MatchDocumentForQuery(query.query_, document_id, IsParallelPolicy<ExecutionPolicy>());
+}
+
+template <typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery &query,
+                                                     const Predicate predicate,
+                                                     const QueryOptions &options) const
+{
+    if (query.epoch_ != epoch_)
+    {
+        return FindTopDocumentsForQuery(ParseQuery(query.raw_query_), predicate, options, false);
+    }
+    return FindTopDocumentsForQuery(query.query_, predicate, options, false);
+}
+
+template <typename Predicate>
+void SearchServer::FindDocumentsContainingAll(const Query &query,
+                                              const std::vector<TermId> &required_terms,
+                                              const Predicate predicate,
+                                              int first_document_index,
+                                              int last_document_index,
+                                              TopDocuments &top_documents) const
+{
+    std::vector<TermId> terms_by_size = required_terms;
+    std::sort(terms_by_size.begin(), terms_by_size.end(),
+              [this](const TermId lhs, const TermId rhs)
+              { return term_postings_[lhs].Size() < term_postings_[rhs].Size(); });
+    std::vector<PostingList::Cursor> required_cursors;
+    for (const TermId term_id : terms_by_size)
+    {
+        required_cursors.emplace_back(term_postings_[term_id]);
+    }
+    // Курсоры минус- и плюс-слов сдвигаются только к найденным документам
+    std::vector<PostingList::Cursor> minus_cursors;
+    for (const TermId term_id : query.minus_terms)
+    {
+        minus_cursors.emplace_back(term_postings_[term_id]);
+    }
+    std::vector<PostingList::Cursor> plus_cursors;
+    for (const TermId term_id : query.plus_terms)
+    {
+        plus_cursors.emplace_back(term_postings_[term_id]);
+    }
+    const auto skip_to = [](PostingList::Cursor &cursor, const int document_index)
+    {
+        cursor.SkipTo(document_index);
+        return !cursor.IsEnd() && cursor.GetDocumentIndex() == document_index;
+    };
+
+    int document_index = first_document_index;
+    while (true)
+    {
+        // Кандидат - следующий документ самого короткого списка. Если в другом
+        // списке его нет, кандидатом становится следующий документ того списка
+        PostingList::Cursor &shortest = required_cursors.front();
+        shortest.SkipTo(document_index);
+        if (shortest.IsEnd() || shortest.GetDocumentIndex() >= last_document_index)
         {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON)
+            return;
+        }
+        document_index = shortest.GetDocumentIndex();
+        bool is_candidate = true;
+        for (std::size_t i = 1; i < required_cursors.size(); ++i)
+        {
+            PostingList::Cursor &cursor = required_cursors[i];
+            cursor.SkipTo(document_index);
+            if (cursor.IsEnd())
             {
-                return lhs.rating > rhs.rating;
+                return;
             }
-            else
+            if (cursor.GetDocumentIndex() != document_index)
             {
-                return lhs.relevance > rhs.relevance;
+                document_index = cursor.GetDocumentIndex();
+                is_candidate = false;
+                break;
             }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+        }
+        if (!is_candidate)
+        {
+            continue;
+        }
+
+        if (!is_removed_document_[document_index] &&
+            std::none_of(minus_cursors.begin(), minus_cursors.end(),
+                         [&](PostingList::Cursor &cursor)
+                         { return skip_to(cursor, document_index); }) &&
+            predicate(document_ids_[document_index],
+                      document_statuses_[document_index],
+                      document_ratings_[document_index]))
+        {
+            // Вклады слов складываются в порядке слов запроса, как при полном переборе
+            double relevance = 0.0;
+            for (std::size_t i = 0; i < plus_cursors.size(); ++i)
+            {
+                if (skip_to(plus_cursors[i], document_index))
+                {
+                    const double term_freq = plus_cursors[i].GetCount() /
+                        static_cast<double>(document_word_counts_[document_index]);
+                    relevance += term_freq * query.inverse_document_freqs[i];
+                }
+            }
+            top_documents.Add({document_ids_[document_index], relevance,
+                               document_ratings_[document_index]});
+        }
+        ++document_index;
+    }
+}
+
+template <typename Predicate>
+void SearchServer::FindAllDocuments(const Query &query, const Predicate predicate,
+                                    int first_document_index, int last_document_index,
+                                    TopDocuments &top_documents) const
+{
+    ScoreAccumulator &accumulator = GetThreadScoreAccumulator();
+    accumulator.Reset(document_ids_.size());
+
+    // Документы с минус-словами исключаются до подсчёта релевантности,
+    // чтобы не тратить на них ни подсчёт, ни проверку предиката
+    ExcludeMinusWordDocuments(query, first_document_index, last_document_index, accumulator);
+
+    for (std::size_t i = 0; i < query.plus_terms.size(); ++i)
     {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        const double inverse_document_freq = query.inverse_document_freqs[i];
+        term_postings_[query.plus_terms[i]].ForEachPostingInRange(
+            first_document_index, last_document_index,
+            [&](const int document_index, const TermCount count)
+            {
+                if (is_removed_document_[document_index] ||
+                    accumulator.IsExcluded(document_index))
+                {
+                    return;
+                }
+                if (predicate(document_ids_[document_index],
+                              document_statuses_[document_index],
+                              document_ratings_[document_index]))
+                {
+                    const double term_freq =
+                        count / static_cast<double>(document_word_counts_[document_index]);
+                    accumulator.Add(document_index, term_freq * inverse_document_freq);
+                }
+            });
     }
-    return matched_documents;
+
+    accumulator.ForEachScored(
+        [this, &top_documents](const int document_index, const double relevance)
+        {
+            top_documents.Add({document_ids_[document_index], relevance,
+                               document_ratings_[document_index]});
+        });
 }
 
 template <typename Predicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query &query,
-                                                     const Predicate predicate) const
+void SearchServer::FindBestDocuments(const Query &query, const Predicate predicate,
+                                     int first_document_index, int last_document_index,
+                                     TopDocuments &top_documents) const
 {
-    std::map<int, double> document_to_relevance;
-    for (const std::string &word : query.plus_words)
+    // Аккумулятор нужен только для отметок о минус-словах
+    ScoreAccumulator &accumulator = GetThreadScoreAccumulator();
+    accumulator.Reset(document_ids_.size());
+    ExcludeMinusWordDocuments(query, first_document_index, last_document_index, accumulator);
+
+    struct TermCursor
+    {
+        PostingList::Cursor cursor;
+        double inverse_document_freq;
+        double max_score;
+        // Место слова в query.plus_terms
+        std::size_t position;
+    };
+
+    std::vector<TermCursor> terms;
+    terms.reserve(query.plus_terms.size());
+    for (std::size_t i = 0; i < query.plus_terms.size(); ++i)
+    {
+        const PostingList &postings = term_postings_[query.plus_terms[i]];
+        const double inverse_document_freq = query.inverse_document_freqs[i];
+        terms.push_back({PostingList::Cursor(postings), inverse_document_freq,
+                         postings.GetMaxTermFreq() * inverse_document_freq, i});
+        terms.back().cursor.SkipTo(first_document_index);
+    }
+    std::sort(terms.begin(), terms.end(),
+              [](const TermCursor &lhs, const TermCursor &rhs)
+              { return lhs.max_score < rhs.max_score; });
+    // max_score_sums[i] - оценка сверху для документа, найденного только в terms[0..i]
+    std::vector<double> max_score_sums(terms.size());
+    double max_score_sum = 0.0;
+    for (std::size_t i = 0; i < terms.size(); ++i)
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        max_score_sum += terms[i].max_score;
+        max_score_sums[i] = max_score_sum;
+    }
+
+    // Вклады слов в релевантность текущего документа в порядке слов запроса.
+    // Складываются в том же порядке, что и при полном переборе, поэтому
+    // релевантности совпадают побитово
+    std::vector<double> term_scores(terms.size());
+    std::vector<double> block_max_scores(terms.size());
+    std::vector<double> block_max_score_sums(terms.size());
+    // Документ с релевантностью ниже порога хуже худшего документа выдачи.
+    // Запас в EPSILON покрывает и сравнение с допуском, и погрешность сумм
+    double threshold = -std::numeric_limits<double>::infinity();
+    // Документы ищутся только по словам начиная с first_essential
+    std::size_t first_essential = 0;
+
+    while (true)
+    {
+        int document_index = std::numeric_limits<int>::max();
+        for (std::size_t i = first_essential; i < terms.size(); ++i)
         {
-            continue;
+            if (!terms[i].cursor.IsEnd())
+            {
+                document_index = std::min(document_index, terms[i].cursor.GetDocumentIndex());
+            }
+        }
+        if (document_index >= last_document_index)
+        {
+            break;
+        }
+
+        // Оценка по границам блоков верна для всех документов до конца
+        // самого короткого из блоков, в которые попадает document_index
+        int block_end = std::numeric_limits<int>::max();
+        double block_max_score_sum = 0.0;
+        for (std::size_t i = 0; i < terms.size(); ++i)
+        {
+            PostingList::Cursor &cursor = terms[i].cursor;
+            cursor.SkipBlocksTo(document_index);
+            block_max_scores[i] = cursor.GetBlockMaxTermFreq() * terms[i].inverse_document_freq;
+            block_max_score_sum += block_max_scores[i];
+            block_end = std::min(block_end, cursor.GetBlockLastDocumentIndex());
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] :
-             word_to_document_freqs_.at(word))
+        if (block_max_score_sum < threshold)
         {
-            const auto &doc = documents_.at(document_id);
-            if (predicate(document_id, doc.status, doc.rating))
+            for (std::size_t i = first_essential; i < terms.size(); ++i)
             {
-                document_to_relevance[document_id] +=
-                    term_freq * inverse_document_freq;
+                terms[i].cursor.SkipTo(block_end + 1);
             }
+            continue;
         }
-    }
 
-    for (const std::string &word : query.minus_words)
-    {
-        if (word_to_document_freqs_.count(word) == 0)
+        std::fill(term_scores.begin(), term_scores.end(), 0.0);
+        const double document_word_count = document_word_counts_[document_index];
+        double score = 0.0;
+        for (std::size_t i = first_essential; i < terms.size(); ++i)
+        {
+            PostingList::Cursor &cursor = terms[i].cursor;
+            if (!cursor.IsEnd() && cursor.GetDocumentIndex() == document_index)
+            {
+                const double term_score =
+                    cursor.GetCount() / document_word_count * terms[i].inverse_document_freq;
+                term_scores[terms[i].position] = term_score;
+                score += term_score;
+                cursor.Next();
+            }
+        }
+        if (is_removed_document_[document_index] || accumulator.IsExcluded(document_index))
         {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word))
+
+        // Оценка сверху для слов terms[0..i] по их блокам
+        double non_essential_sum = 0.0;
+        for (std::size_t i = 0; i < first_essential; ++i)
         {
-            document_to_relevance.erase(document_id);
+            non_essential_sum += block_max_scores[i];
+            block_max_score_sums[i] = non_essential_sum;
+        }
+        bool is_pruned = false;
+        for (std::size_t i = first_essential; i-- > 0;)
+        {
+            if (score + block_max_score_sums[i] < threshold)
+            {
+                is_pruned = true;
+                break;
+            }
+            PostingList::Cursor &cursor = terms[i].cursor;
+            cursor.SkipTo(document_index);
+            if (!cursor.IsEnd() && cursor.GetDocumentIndex() == document_index)
+            {
+                const double term_score =
+                    cursor.GetCount() / document_word_count * terms[i].inverse_document_freq;
+                term_scores[terms[i].position] = term_score;
+                score += term_score;
+            }
+        }
+        if (is_pruned || !predicate(document_ids_[document_index],
+                                    document_statuses_[document_index],
+                                    document_ratings_[document_index]))
+        {
+            continue;
         }
-    }
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance)
-    {
-        matched_documents.push_back(
-            {document_id, relevance, documents_.at(document_id).rating});
+        double relevance = 0.0;
+        for (const double term_score : term_scores)
+        {
+            relevance += term_score;
+        }
+        top_documents.Add({document_ids_[document_index], relevance,
+                           document_ratings_[document_index]});
+        if (top_documents.IsFull())
+        {
+            threshold = top_documents.GetWorst().relevance - 2 * EPSILON;
+            while (first_essential < terms.size() &&
+                   max_score_sums[first_essential] < threshold)
+            {
+                ++first_essential;
+            }
+        }
     }
-    return matched_documents;
-}
\ No newline at end of file
+}
@@ -0,0 +1,129 @@
+#include <cstdlib>
+#include <stdexcept>
+
+#include "sharded_search_server.h"
+#include "string_processing.h"
+
+using namespace std::string_literals;
+
+ShardedSearchServer::ShardedSearchServer(std::size_t shard_count,
+                                         std::string_view stop_words_text)
+{
+    if (shard_count == 0)
+    {
+        throw std::invalid_argument("Shard count must be positive"s);
+    }
+    shards_.reserve(shard_count);
+    for (std::size_t i = 0; i < shard_count; ++i)
+    {
+        shards_.emplace_back(stop_words_text);
+    }
+}
+
+void ShardedSearchServer::AddDocument(int document_id, std::string_view document,
+                                      DocumentStatus status, const std::vector<int> &ratings)
+{
+    GetShard(document_id).AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id)
+{
+    GetShard(document_id).RemoveDocument(document_id);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+    std::string_view raw_query,
+    const DocumentStatus expected_status,
+    const QueryOptions &options) const
+{
+    // Шарды ищут по статусу сами: редкий статус перебирается по списку
+    // документов, а выдачи попадают в кэш шарда
+    return FindTopDocumentsInShards(
+        raw_query, options,
+        [expected_status](const SearchServer &shard, const SearchServer::PreparedQuery &query,
+                          const QueryOptions &shard_options)
+        { return shard.FindTopDocuments(query, expected_status, shard_options); });
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query,
+                                                            const QueryOptions &options) const
+{
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL, options);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+    std::string_view raw_query,
+    const DocumentStatus expected_status) const
+{
+    return FindTopDocuments(raw_query, expected_status, QueryOptions{});
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query) const
+{
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(
+    std::string_view raw_query, int document_id) const
+{
+    return GetShard(document_id).MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const
+{
+    int document_count = 0;
+    for (const SearchServer &shard : shards_)
+    {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+std::size_t ShardedSearchServer::GetShardCount() const
+{
+    return shards_.size();
+}
+
+SearchServer &ShardedSearchServer::GetShard(int document_id)
+{
+    // Отрицательный ID попадает в шард, который его и отвергнет
+    return shards_[std::abs(document_id % static_cast<int>(shards_.size()))];
+}
+
+const SearchServer &ShardedSearchServer::GetShard(int document_id) const
+{
+    return shards_[std::abs(document_id % static_cast<int>(shards_.size()))];
+}
+
+std::vector<SearchServer::PreparedQuery> ShardedSearchServer::PrepareShardQueries(
+    std::string_view raw_query) const
+{
+    // Число документов со словом по всем шардам. Минус-слова тоже
+    // попадают в статистику, но их IDF не используется
+    std::map<std::string_view, int> word_document_counts;
+    for (std::string_view word : SplitIntoWords(raw_query))
+    {
+        if (!word.empty() && (word[0] == '-' || word[0] == '+'))
+        {
+            word.remove_prefix(1);
+        }
+        if (word_document_counts.count(word) > 0)
+        {
+            continue;
+        }
+        int &word_document_count = word_document_counts[word];
+        for (const SearchServer &shard : shards_)
+        {
+            word_document_count += shard.GetWordDocumentCount(word);
+        }
+    }
+
+    const int document_count = GetDocumentCount();
+    std::vector<SearchServer::PreparedQuery> queries;
+    queries.reserve(shards_.size());
+    for (const SearchServer &shard : shards_)
+    {
+        queries.push_back(shard.PrepareQuery(raw_query, document_count, word_document_counts));
+    }
+    return queries;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include <execution>
+#include <numeric>
+
+#include "document.h"
+#include "search_server.h"
+#include "top_documents.h"
+
+/**
+ * Индекс, разделённый на несколько независимых SearchServer (шардов).
+ * Документ хранится в шарде с номером ID % число шардов. Запрос выполняется
+ * во всех шардах параллельно с IDF по статистике всех шардов, после чего
+ * лучшие документы шардов сливаются. Выдача такая же, как у одного
+ * SearchServer со всеми документами
+ */
+class ShardedSearchServer
+{
+public:
+    ShardedSearchServer(std::size_t shard_count, std::string_view stop_words_text);
+
+    void AddDocument(int document_id, std::string_view document,
+                     DocumentStatus status, const std::vector<int> &ratings);
+
+    void RemoveDocument(int document_id);
+
+    /**
+     * Предикат вызывается из потоков разных шардов
+     */
+    template <typename Predicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                           const Predicate predicate,
+                                           const QueryOptions &options) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                           const DocumentStatus expected_status,
+                                           const QueryOptions &options) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                           const QueryOptions &options) const;
+
+    template <typename Predicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                           const Predicate predicate) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                           const DocumentStatus expected_status) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+        std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+
+    std::size_t GetShardCount() const;
+
+private:
+    std::vector<SearchServer> shards_;
+
+    SearchServer &GetShard(int document_id);
+
+    const SearchServer &GetShard(int document_id) const;
+
+    /**
+     * Подготавливает запрос для каждого шарда с IDF по всем шардам.
+     * Некорректный запрос приводит к исключению до начала поиска
+     */
+    std::vector<SearchServer::PreparedQuery> PrepareShardQueries(
+        std::string_view raw_query) const;
+
+    /**
+     * Выполняет запрос во всех шардах и сливает их выдачи в страницу options.
+     * shard_search(shard, query, shard_options) ищет в одном шарде
+     */
+    template <typename ShardSearch>
+    std::vector<Document> FindTopDocumentsInShards(std::string_view raw_query,
+                                                   const QueryOptions &options,
+                                                   ShardSearch shard_search) const;
+};
+
+// templates IMPL
+
+template <typename Predicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query,
+                                                            const Predicate predicate,
+                                                            const QueryOptions &options) const
+{
+    return FindTopDocumentsInShards(
+        raw_query, options,
+        [&predicate](const SearchServer &shard, const SearchServer::PreparedQuery &query,
+                     const QueryOptions &shard_options)
+        { return shard.FindTopDocuments(query, predicate, shard_options); });
+}
+
+template <typename Predicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query,
+                                                            const Predicate predicate) const
+{
+    return FindTopDocuments(raw_query, predicate, QueryOptions{});
+}
+
+template <typename ShardSearch>
+std::vector<Document> ShardedSearchServer::FindTopDocumentsInShards(
+    std::string_view raw_query,
+    const QueryOptions &options,
+    ShardSearch shard_search) const
+{
+    const std::vector<SearchServer::PreparedQuery> queries = PrepareShardQueries(raw_query);
+
+    // Каждый шард отбирает столько лучших документов, сколько нужно
+    // для страницы, страница вырезается после слияния
+    QueryOptions shard_options = options;
+    shard_options.limit = GetMaxResultCount(options);
+    shard_options.offset = 0;
+    std::vector<std::vector<Document>> shard_documents(shards_.size());
+    std::vector<std::size_t> shard_indexes(shards_.size());
+    std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+    std::for_each(std::execution::par, shard_indexes.begin(), shard_indexes.end(),
+                  [&](const std::size_t i)
+                  {
+                      shard_documents[i] = shard_search(shards_[i], queries[i], shard_options);
+                  });
+
+    TopDocuments top_documents(shard_options.limit);
+    for (const std::vector<Document> &documents : shard_documents)
+    {
+        for (const Document &document : documents)
+        {
+            top_documents.Add(document);
+        }
+    }
+    std::vector<Document> documents = top_documents.Extract();
+    documents.erase(documents.begin(),
+                    documents.begin() + std::min(options.offset, documents.size()));
+    return documents;
+}
@@ -1,27 +1,19 @@
 #include "string_processing.h"
 
-std::vector<std::string> SplitIntoWords(const std::string &text)
+std::vector<std::string_view> SplitIntoWords(std::string_view text)
 {
-  std::vector<std::string> words;
-  std::string word;
-  for (const char c : text)
+  std::vector<std::string_view> words;
+  std::size_t word_begin = 0;
+  for (std::size_t i = 0; i <= text.size(); ++i)
   {
-    if (c == ' ')
+    if (i == text.size() || text[i] == ' ')
     {
-      if (!word.empty())
+      if (i > word_begin)
       {
-        words.push_back(word);
-        word.clear();
+        words.push_back(text.substr(word_begin, i - word_begin));
       }
+      word_begin = i + 1;
     }
-    else
-    {
-      word += c;
-    }
-  }
-  if (!word.empty())
-  {
-    words.push_back(word);
   }
 
   return words;
@@ -1,6 +1,9 @@
 #pragma once
 
-#include <string>
+#include <string_view>
 #include <vector>
 
-std::vector<std::string> SplitIntoWords(const std::string &text);
\ No newline at end of file
+/**
+ * Возвращаемые слова ссылаются на символы text
+ */
+std::vector<std::string_view> SplitIntoWords(std::string_view text);
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "term_dictionary.h"
+#include "memory_usage.h"
+
+TermDictionary::TermDictionary(const TermDictionary &other)
+    : word_to_id_(other.word_to_id_),
+      word_memory_usage_(other.word_memory_usage_)
+{
+    RebuildIdToWord();
+}
+
+TermDictionary &TermDictionary::operator=(const TermDictionary &other)
+{
+    if (this != &other)
+    {
+        word_to_id_ = other.word_to_id_;
+        word_memory_usage_ = other.word_memory_usage_;
+        RebuildIdToWord();
+    }
+    return *this;
+}
+
+TermId TermDictionary::Add(std::string_view word)
+{
+    if (const auto it = word_to_id_.find(word); it != word_to_id_.end())
+    {
+        return it->second;
+    }
+    const TermId term_id = static_cast<TermId>(id_to_word_.size());
+    const auto it = word_to_id_.emplace(std::string(word), term_id).first;
+    id_to_word_.push_back(&it->first);
+    word_memory_usage_ += ::GetMemoryUsage(it->first);
+    return term_id;
+}
+
+std::optional<TermId> TermDictionary::Find(std::string_view word) const
+{
+    const auto it = word_to_id_.find(word);
+    if (it == word_to_id_.end())
+    {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::string_view TermDictionary::GetWord(TermId term_id) const
+{
+    return *id_to_word_.at(term_id);
+}
+
+std::size_t TermDictionary::Size() const
+{
+    return id_to_word_.size();
+}
+
+std::size_t TermDictionary::GetMemoryUsage() const
+{
+    return ::GetMemoryUsage(word_to_id_) + word_memory_usage_ +
+           ::GetMemoryUsage(id_to_word_);
+}
+
+void TermDictionary::RebuildIdToWord()
+{
+    id_to_word_.assign(word_to_id_.size(), nullptr);
+    for (const auto &[word, term_id] : word_to_id_)
+    {
+        id_to_word_[term_id] = &word;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using TermId = std::uint32_t;
+
+/**
+ * Словарь терминов: каждому различному слову один раз назначается
+ * плотный 32-битный ID, по которому дальше адресуются все данные о слове
+ */
+class TermDictionary
+{
+public:
+    TermDictionary() = default;
+    TermDictionary(const TermDictionary &other);
+    TermDictionary(TermDictionary &&other) = default;
+
+    TermDictionary &operator=(const TermDictionary &other);
+    TermDictionary &operator=(TermDictionary &&other) = default;
+
+    /**
+     * Возвращает ID слова, добавляя слово в словарь, если его там ещё нет
+     */
+    TermId Add(std::string_view word);
+
+    std::optional<TermId> Find(std::string_view word) const;
+
+    std::string_view GetWord(TermId term_id) const;
+
+    std::size_t Size() const;
+
+    std::size_t GetMemoryUsage() const;
+
+private:
+    std::map<std::string, TermId, std::less<>> word_to_id_;
+    // Объём памяти под сами строки слов, учитывается при добавлении
+    std::size_t word_memory_usage_ = 0;
+
+    // Указывают на ключи word_to_id_, которые не перемещаются в памяти
+    std::vector<const std::string *> id_to_word_;
+
+    void RebuildIdToWord();
+};
@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <cmath>
+
+#include "top_documents.h"
+
+bool IsBetterDocument(const Document &lhs, const Document &rhs)
+{
+    if (std::abs(lhs.relevance - rhs.relevance) >= EPSILON)
+    {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating)
+    {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+TopDocuments::TopDocuments(std::size_t max_count)
+    : max_count_(max_count) {}
+
+void TopDocuments::Add(const Document &document)
+{
+    if (heap_.size() < max_count_)
+    {
+        heap_.push_back(document);
+        std::push_heap(heap_.begin(), heap_.end(), IsBetterDocument);
+        return;
+    }
+    if (max_count_ == 0 || !IsBetterDocument(document, heap_.front()))
+    {
+        return;
+    }
+    std::pop_heap(heap_.begin(), heap_.end(), IsBetterDocument);
+    heap_.back() = document;
+    std::push_heap(heap_.begin(), heap_.end(), IsBetterDocument);
+}
+
+bool TopDocuments::IsFull() const
+{
+    return heap_.size() == max_count_;
+}
+
+const Document &TopDocuments::GetWorst() const
+{
+    return heap_.front();
+}
+
+std::vector<Document> TopDocuments::Extract()
+{
+    std::sort_heap(heap_.begin(), heap_.end(), IsBetterDocument);
+    return std::move(heap_);
+}
\ No newline at end of file
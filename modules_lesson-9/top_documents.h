@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "document.h"
+
+const double EPSILON = 1e-6;
+
+/**
+ * Порядок документов в выдаче: по убыванию релевантности, при равной
+ * (с точностью до EPSILON) релевантности — по убыванию рейтинга,
+ * при равном рейтинге — по возрастанию ID
+ */
+bool IsBetterDocument(const Document &lhs, const Document &rhs);
+
+/**
+ * Хранит не более max_count лучших из добавленных документов.
+ * Документы лежат в куче, на вершине которой худший из них
+ */
+class TopDocuments
+{
+public:
+    explicit TopDocuments(std::size_t max_count);
+
+    void Add(const Document &document);
+
+    bool IsFull() const;
+
+    /**
+     * Худший из отобранных документов. Документ, который не лучше него,
+     * не попадёт в заполненную выдачу
+     */
+    const Document &GetWorst() const;
+
+    /**
+     * Отобранные документы от лучшего к худшему
+     */
+    std::vector<Document> Extract();
+
+private:
+    std::size_t max_count_;
+    std::vector<Document> heap_;
+};
\ No newline at end of file